@@ -106,9 +106,12 @@ SOURCES += \
     cpprefacter.cpp \
     parser/cppparser.cpp \
     parser/cpppreprocessor.cpp \
+    parser/preprocessedheadercache.cpp \
     parser/cpptokenizer.cpp \
     parser/parserutils.cpp \
+    parser/parsescheduler.cpp \
     parser/statementmodel.cpp \
+    parser/systemheadercache.cpp \
     problems/freeprojectsetformat.cpp \
     problems/ojproblemset.cpp \
     problems/problemcasevalidator.cpp \
@@ -242,9 +245,12 @@ HEADERS += \
     gdbmiresultparser.h \
     parser/cppparser.h \
     parser/cpppreprocessor.h \
+    parser/preprocessedheadercache.h \
     parser/cpptokenizer.h \
     parser/parserutils.h \
+    parser/parsescheduler.h \
     parser/statementmodel.h \
+    parser/systemheadercache.h \
     problems/freeprojectsetformat.h \
     problems/ojproblemset.h \
     problems/problemcasevalidator.h \
@@ -371,11 +371,11 @@ void ProjectCompiler::writeMakeObjFilesRules(QFile &file)
         QString objStr=genMakePath2(shortFileName);
         // if we have scanned it, use scanned info
         if (parser && parser->scannedFiles().contains(unit->fileName())) {
-            QSet<QString> fileIncludes = parser->getFileIncludes(unit->fileName());
+            FileIdSet fileIncludes = parser->getFileIncludeIds(unit->fileName());
             foreach(const PProjectUnit &unit2, projectUnits) {
                 if (unit2==unit)
                     continue;
-                if (fileIncludes.contains(unit2->fileName())) {
+                if (fileIncludes.contains(FileIdTable::findId(unit2->fileName()))) {
                     if (mProject->options().usePrecompiledHeader &&
                            unit2->fileName() == mProject->options().precompiledHeader)
                         precompileStr = " $(PCH) ";
@@ -25,6 +25,15 @@
 #include <QTextCodec>
 #include "syntaxermanager.h"
 #include "project.h"
+#include "qsynedit/syntaxer/cpp.h"
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QThreadPool>
+#include <qt_utils/charsetinfo.h>
+
+// how long to wait for the scanning threads before updating the progress, in milliseconds
+#define SCAN_PROGRESS_INTERVAL 50
 
 CppRefacter::CppRefacter(QObject *parent) : QObject(parent)
 {
@@ -35,7 +44,7 @@ bool CppRefacter::findOccurence(Editor *editor, const QSynedit::BufferCoord &pos
 {
     if (!editor->parser())
         return false;
-    if (!editor->parser()->freeze())
+    if (!editor->parser()->tryFreeze())
         return false;
     auto action = finally([&editor]{
         editor->parser()->unFreeze();
@@ -84,7 +93,8 @@ bool CppRefacter::findOccurence(const QString &statementFullname, SearchFileScop
     if (!parser)
         return false;
     {
-        parser->freeze();
+        if (!parser->tryFreeze())
+            return false;
         auto action = finally([&parser]{
             parser->unFreeze();
         });
@@ -103,6 +113,183 @@ bool CppRefacter::findOccurence(const QString &statementFullname, SearchFileScop
     }
 }
 
+// references of the statement recorded by the parser, false if they can't be used.
+// currentContents is nullptr if the file is not changed after it's parsed
+static bool indexedReferences(const PCppParser& parser,
+                              const QString& filename,
+                              const QStringList* currentContents,
+                              const PStatement& statement,
+                              PFileReferences& fileReferences,
+                              QVector<SymbolReference>& references)
+{
+    fileReferences = parser->references(filename);
+    if (!fileReferences)
+        return false;
+    if (currentContents && *currentContents != fileReferences->lines)
+        return false;
+    // some identifiers with the name are not resolved when parsing
+    if (fileReferences->unresolvedNames.contains(statement->command))
+        return false;
+    references = fileReferences->referencesOf(statement);
+    return true;
+}
+
+static PSearchResultTreeItem newFileResultItem(const QString& filename)
+{
+    PSearchResultTreeItem parentItem = std::make_shared<SearchResultTreeItem>();
+    parentItem->filename = filename;
+    parentItem->parent = nullptr;
+    return parentItem;
+}
+
+static void addOccurence(const PSearchResultTreeItem& parentItem, int line, int start, int len,
+                         const QString& lineText)
+{
+    PSearchResultTreeItem item = std::make_shared<SearchResultTreeItem>();
+    item->filename = parentItem->filename;
+    item->line = line;
+    item->start = start;
+    item->len = len;
+    item->parent = parentItem.get();
+    item->text = lineText;
+    item->text.replace('\t',' ');
+    parentItem->results.append(item);
+}
+
+static PSearchResultTreeItem searchResultOfReferences(const QString& filename,
+                                                      const PFileReferences& fileReferences,
+                                                      const QVector<SymbolReference>& references)
+{
+    PSearchResultTreeItem parentItem = newFileResultItem(filename);
+    foreach (const SymbolReference& reference, references) {
+        addOccurence(parentItem, reference.line, reference.column, reference.length,
+                     fileReferences->lines[reference.line-1]);
+    }
+    return parentItem;
+}
+
+// resolves every identifier with the statement's name in the lines.
+// It doesn't use widgets, so it can be run in worker threads.
+// The parser must be frozen by the caller until it returns.
+static PSearchResultTreeItem scanOccurences(const QString& filename,
+                                            const QStringList& lines,
+                                            const PStatement& statement,
+                                            const PCppParser& parser,
+                                            const QAtomicInt* cancelFlag)
+{
+    PSearchResultTreeItem parentItem = newFileResultItem(filename);
+    QSynedit::CppSyntaxer syntaxer;
+    QVector<QSynedit::SyntaxState> lineEndStates;
+    lineEndStates.reserve(lines.count());
+    for (int posY=0;posY<lines.count();posY++) {
+        if (cancelFlag && cancelFlag->loadAcquire())
+            break;
+        const QString& line = lines[posY];
+        if (posY == 0) {
+            syntaxer.resetState();
+        } else {
+            syntaxer.setState(lineEndStates[posY-1]);
+        }
+        syntaxer.setLine(line,posY);
+        while (!syntaxer.eol()) {
+            int start = syntaxer.getTokenPos() + 1;
+            QString token = syntaxer.getToken();
+            QSynedit::PTokenAttribute attr = syntaxer.getTokenAttribute();
+            if (attr && attr->tokenType()==QSynedit::TokenType::Identifier
+                    && token == statement->command) {
+                //same name symbol , test if the same statement;
+                QSynedit::BufferCoord p;
+                p.line = posY+1;
+                p.ch = start+1;
+
+                QStringList expression = Editor::getExpressionAtPosition(
+                            lines.count(),
+                            [&lines](int line){ return lines[line]; },
+                            [&lineEndStates](int line){ return lineEndStates[line]; },
+                            p);
+                PStatement tokenStatement = parser->findStatementOfWhileFrozen(
+                            filename,
+                            expression, p.line);
+                if (tokenStatement
+                        && (tokenStatement->line == statement->line)
+                        && (tokenStatement->fileName == statement->fileName)) {
+                    addOccurence(parentItem, p.line, start, token.length(), line);
+                }
+            }
+            syntaxer.next();
+        }
+        lineEndStates.append(syntaxer.getState());
+    }
+    return parentItem;
+}
+
+/**
+ * @brief Finds occurrences of a statement in a file with its own syntaxer,
+ * so files can be scanned in the thread pool at the same time.
+ */
+class OccurenceScanTask : public QRunnable {
+public:
+    /**
+     * @param codec to read the file if it's loaded from the disk, nullptr to detect the encoding
+     */
+    OccurenceScanTask(const QString& filename,
+                      const QStringList& contents,
+                      bool loadFromDisk,
+                      QTextCodec* codec,
+                      const PStatement& statement,
+                      const PCppParser& parser,
+                      const QAtomicInt* cancelFlag):
+        mFilename(filename),
+        mContents(contents),
+        mLoadFromDisk(loadFromDisk),
+        mCodec(codec),
+        mStatement(statement),
+        mParser(parser),
+        mCancelFlag(cancelFlag),
+        mFinished(0)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override {
+        if (mLoadFromDisk) {
+            if (mCodec)
+                mContents = readFileToLines(mFilename, mCodec);
+            else
+                mContents = readFileToLines(mFilename);
+        }
+        mResult = scanOccurences(mFilename, mContents, mStatement, mParser, mCancelFlag);
+        mFinished.storeRelease(1);
+    }
+
+    bool isFinished() const { return mFinished.loadAcquire(); }
+    const PSearchResultTreeItem& result() const { return mResult; }
+private:
+    QString mFilename;
+    QStringList mContents;
+    bool mLoadFromDisk;
+    QTextCodec* mCodec;
+    PStatement mStatement;
+    PCppParser mParser;
+    const QAtomicInt* mCancelFlag;
+    QAtomicInt mFinished;
+    PSearchResultTreeItem mResult;
+};
+
+using POccurenceScanTask = std::shared_ptr<OccurenceScanTask>;
+
+// codec of the file encoding setting, nullptr if the encoding should be detected
+static QTextCodec* codecOfEncoding(const QByteArray& encoding)
+{
+    if (encoding == ENCODING_AUTO_DETECT)
+        return nullptr;
+    if (encoding == ENCODING_SYSTEM_DEFAULT)
+        return QTextCodec::codecForName(pCharsetInfoManager->getDefaultSystemEncoding());
+    if (encoding == ENCODING_UTF8_BOM)
+        return QTextCodec::codecForName(ENCODING_UTF8);
+    return QTextCodec::codecForName(encoding);
+}
+
 static QString fullParentName(PStatement statement) {
     PStatement parent = statement->parentScope.lock();
     if (parent) {
@@ -113,7 +300,7 @@ static QString fullParentName(PStatement statement) {
 }
 void CppRefacter::renameSymbol(Editor *editor, const QSynedit::BufferCoord &pos, const QString &newWord)
 {
-    if (!editor->parser()->freeze())
+    if (!editor->parser()->tryFreeze())
         return;
     auto action = finally([&editor]{
         editor->parser()->unFreeze();
@@ -190,25 +377,74 @@ void CppRefacter::doFindOccurenceInProject(PStatement statement, std::shared_ptr
                 pMainWindow->project()->unitList().count(),
                 pMainWindow);
     progressDlg.setWindowModality(Qt::WindowModal);
+    QList<PProjectUnit> units = project->unitList();
+    // Files not covered by the references recorded by the parser are scanned in the thread pool.
+    // Results are added in the order of the units, as soon as the files before them are done.
+    QThreadPool pool;
+    QAtomicInt cancelled;
+    QList<POccurenceScanTask> tasks;
+    QList<PSearchResultTreeItem> items;
+    foreach (const PProjectUnit& unit, units) {
+        if (!isCFile(unit->fileName()) && !isHFile(unit->fileName())) {
+            items.append(std::make_shared<SearchResultTreeItem>());
+            continue;
+        }
+        QStringList buffer;
+        bool opened = pMainWindow->editorList()->getContentFromOpenedEditor(
+                    unit->fileName(),buffer);
+        PFileReferences fileReferences;
+        QVector<SymbolReference> references;
+        if (indexedReferences(parser, unit->fileName(), opened?&buffer:nullptr, statement,
+                              fileReferences, references)) {
+            items.append(searchResultOfReferences(unit->fileName(), fileReferences, references));
+            continue;
+        }
+        // decoded with the encoding setting of the unit, the same as findOccurenceInFile()
+        QTextCodec* codec = nullptr;
+        if (!opened)
+            codec = codecOfEncoding(
+                        unit->encoding()==ENCODING_PROJECT?project->options().encoding:unit->encoding());
+        POccurenceScanTask task = std::make_shared<OccurenceScanTask>(
+                    unit->fileName(), buffer, !opened, codec, statement, parser, &cancelled);
+        tasks.append(task);
+        items.append(PSearchResultTreeItem());
+        pool.start(task.get());
+    }
     int i=0;
-    foreach (const PProjectUnit& unit, project->unitList()) {
-        i++;
-        if (isCFile(unit->fileName()) || isHFile(unit->fileName())) {
-            progressDlg.setValue(i);
-            progressDlg.setLabelText(tr("Searching...")+"<br/>"+unit->fileName());
-
-            if (progressDlg.wasCanceled())
-                break;
-            PSearchResultTreeItem item = findOccurenceInFile(
-                        unit->fileName(),
-                        unit->encoding()==ENCODING_PROJECT?project->options().encoding:unit->encoding(),
-                        statement,
-                        parser);
-            if (item && !(item->results.isEmpty())) {
+    int taskIndex=0;
+    auto collectResults=[&]() {
+        bool updated = false;
+        while (i<items.count()) {
+            PSearchResultTreeItem item = items[i];
+            if (!item) {
+                const POccurenceScanTask& task = tasks[taskIndex];
+                if (!task->isFinished())
+                    break;
+                item = task->result();
+                taskIndex++;
+            }
+            if (!item->results.isEmpty()) {
                 results->results.append(item);
+                updated = true;
             }
+            i++;
+            progressDlg.setValue(i);
+            if (i<items.count())
+                progressDlg.setLabelText(tr("Searching...")+"<br/>"+units[i]->fileName());
+        }
+        if (updated)
+            pMainWindow->searchResultModel()->notifySearchResultsUpdated();
+    };
+    while (!pool.waitForDone(SCAN_PROGRESS_INTERVAL)) {
+        collectResults();
+        QCoreApplication::processEvents();
+        if (progressDlg.wasCanceled()) {
+            cancelled.storeRelease(1);
+            pool.waitForDone();
+            return;
         }
     }
+    collectResults();
 }
 
 PSearchResultTreeItem CppRefacter::findOccurenceInFile(
@@ -217,83 +453,44 @@ PSearchResultTreeItem CppRefacter::findOccurenceInFile(
         const PStatement &statement,
         const PCppParser& parser)
 {
-    PSearchResultTreeItem parentItem = std::make_shared<SearchResultTreeItem>();
-    parentItem->filename = filename;
-    parentItem->parent = nullptr;
     QStringList buffer;
-    Editor editor(nullptr);
-    if (pMainWindow->editorList()->getContentFromOpenedEditor(
-                filename,buffer)){
-        editor.document()->setContents(buffer);
-    } else if (!fileExists(filename)){
-        return parentItem;
-    } else {
+    bool opened = pMainWindow->editorList()->getContentFromOpenedEditor(
+                filename,buffer);
+    PFileReferences fileReferences;
+    QVector<SymbolReference> references;
+    if (indexedReferences(parser, filename, opened?&buffer:nullptr, statement,
+                          fileReferences, references))
+        return searchResultOfReferences(filename, fileReferences, references);
+    // the file is changed after it's parsed, find them the slow way
+    if (!opened) {
+        if (!fileExists(filename))
+            return newFileResultItem(filename);
+        Editor editor(nullptr);
         QByteArray encoding;
         try {
             editor.document()->loadFromFile(filename,fileEncoding,encoding);
         } catch (FileError e) {
             //don't handle it;
-            return parentItem;
+            return newFileResultItem(filename);
         }
+        buffer = editor.document()->contents();
     }
-    editor.setSyntaxer(syntaxerManager.getSyntaxer(QSynedit::ProgrammingLanguage::CPP));
-    int posY = 0;
-    while (posY < editor.document()->count()) {
-        QString line = editor.document()->getLine(posY);
-        if (line.isEmpty()) {
-            posY++;
-            continue;
-        }
-
-        if (posY == 0) {
-            editor.syntaxer()->resetState();
-        } else {
-            editor.syntaxer()->setState(
-                        editor.document()->getSyntaxState(posY-1));
-        }
-        editor.syntaxer()->setLine(line,posY);
-        while (!editor.syntaxer()->eol()) {
-            int start = editor.syntaxer()->getTokenPos() + 1;
-            QString token = editor.syntaxer()->getToken();
-            QSynedit::PTokenAttribute attr = editor.syntaxer()->getTokenAttribute();
-            if (attr && attr->tokenType()==QSynedit::TokenType::Identifier) {
-                if (token == statement->command) {
-                    //same name symbol , test if the same statement;
-                    QSynedit::BufferCoord p;
-                    p.line = posY+1;
-                    p.ch = start+1;
-
-                    QStringList expression = editor.getExpressionAtPosition(p);
-                    PStatement tokenStatement = parser->findStatementOf(
-                                filename,
-                                expression, p.line);
-                    if (tokenStatement
-                            && (tokenStatement->line == statement->line)
-                            && (tokenStatement->fileName == statement->fileName)) {
-                        PSearchResultTreeItem item = std::make_shared<SearchResultTreeItem>();
-                        item->filename = filename;
-                        item->line = p.line;
-                        item->start = start;
-                        item->len = token.length();
-                        item->parent = parentItem.get();
-                        item->text = line;
-                        item->text.replace('\t',' ');
-                        parentItem->results.append(item);
-                    }
-                }
-            }
-            editor.syntaxer()->next();
-        }
-        posY++;
-    }
-    return parentItem;
+    return scanOccurences(filename, buffer, statement, parser, nullptr);
 }
 
 void CppRefacter::renameSymbolInFile(const QString &filename, const PStatement &statement,  const QString &newWord, const PCppParser &parser)
 {
     QStringList buffer;
     Editor * oldEditor=pMainWindow->editorList()->getOpenedEditorByFilename(filename);
+    PFileReferences fileReferences;
+    QVector<SymbolReference> references;
+    QSet<QPair<int,int>> referencePositions;
     if (oldEditor){
+        QStringList contents = oldEditor->contents();
+        bool indexed = indexedReferences(parser, filename, &contents, statement,
+                                         fileReferences, references);
+        foreach (const SymbolReference& reference, references)
+            referencePositions.insert(QPair<int,int>(reference.line, reference.column));
         QSynedit::PSyntaxer syntaxer = syntaxerManager.getSyntaxer(QSynedit::ProgrammingLanguage::CPP);
         int posY = 0;
         oldEditor->clearSelection();
@@ -312,7 +509,10 @@ void CppRefacter::renameSymbolInFile(const QString &filename, const PStatement &
             while (!syntaxer->eol()) {
                 int start = syntaxer->getTokenPos() + 1;
                 QString token = syntaxer->getToken();
-                if (token == statement->command) {
+                if (indexed) {
+                    if (referencePositions.contains(QPair<int,int>(posY+1, start)))
+                        token = newWord;
+                } else if (token == statement->command) {
                     //same name symbol , test if the same statement;
                     QSynedit::BufferCoord p;
                     p.line = posY+1;
@@ -348,6 +548,11 @@ void CppRefacter::renameSymbolInFile(const QString &filename, const PStatement &
                         e.reason());
             return;
         }
+        QStringList contents = editor.document()->contents();
+        bool indexed = indexedReferences(parser, filename, &contents, statement,
+                                         fileReferences, references);
+        foreach (const SymbolReference& reference, references)
+            referencePositions.insert(QPair<int,int>(reference.line, reference.column));
 
         QStringList newContents;
         int posY = 0;
@@ -364,7 +569,10 @@ void CppRefacter::renameSymbolInFile(const QString &filename, const PStatement &
             while (!editor.syntaxer()->eol()) {
                 int start = editor.syntaxer()->getTokenPos() + 1;
                 QString token = editor.syntaxer()->getToken();
-                if (token == statement->command) {
+                if (indexed) {
+                    if (referencePositions.contains(QPair<int,int>(posY+1, start)))
+                        token = newWord;
+                } else if (token == statement->command) {
                     //same name symbol , test if the same statement;
                     QSynedit::BufferCoord p;
                     p.line = posY+1;
@@ -53,6 +53,7 @@
 #include "editorlist.h"
 #include <QDebug>
 #include "project.h"
+#include "parser/parsescheduler.h"
 #include <qt_utils/charsetinfo.h>
 
 QHash<ParserLanguage,std::weak_ptr<CppParser>> Editor::mSharedParsers;
@@ -226,6 +227,9 @@ Editor::Editor(QWidget *parent, const QString& filename,
 Editor::~Editor() {
     //qDebug()<<"editor "<<mFilename<<" deleted";
     cleanAutoBackup();
+    //requests left for its parser are dropped once the parser is only used by them
+    if (mParser)
+        QMetaObject::invokeMethod(ParseScheduler::instance(), "schedule", Qt::QueuedConnection);
 }
 
 void Editor::loadFile(QString filename) {
@@ -1150,16 +1154,24 @@ void Editor::onPreparePaintHighlightToken(int line, int aChar, const QString &to
     //        PStatement statement = mParser->findStatementOf(mFilename,
     //          s , p.Line);
             StatementKind kind;
-            if (mParser->parsing()){
-                kind=mIdentCache.value(QString("%1 %2").arg(aChar).arg(token),StatementKind::skUnknown);
-            } else {
-                QStringList expression = getExpressionAtPosition(p);
-                PStatement statement = parser()->findStatementOf(
-                            filename(),
-                            expression,
-                            p.line);
-                kind = getKindOfStatement(statement);
-                mIdentCache.insert(QString("%1 %2").arg(aChar).arg(token),kind);
+            // kinds found by the last parse, only look up the changed lines and complex expressions
+            PFileSemanticTokens semanticTokens = mParser->semanticTokens(mFilename);
+            if (!semanticTokens || !semanticTokens->kindAt(line,aChar,lineText,kind)) {
+                // only fall back to the cache while the parser is writing the symbols
+                if (!mParser->tryFreeze()){
+                    kind=mIdentCache.value(QString("%1 %2").arg(aChar).arg(token),StatementKind::skUnknown);
+                } else {
+                    auto action = finally([this]{
+                        mParser->unFreeze();
+                    });
+                    QStringList expression = getExpressionAtPosition(p);
+                    PStatement statement = parser()->findStatementOf(
+                                filename(),
+                                expression,
+                                p.line);
+                    kind = getKindOfStatement(statement);
+                    mIdentCache.insert(QString("%1 %2").arg(aChar).arg(token),kind);
+                }
             }
             if (kind == StatementKind::skUnknown) {
                 QSynedit::BufferCoord pBeginPos,pEndPos;
@@ -2210,24 +2222,37 @@ QStringList Editor::getOwnerExpressionAndMemberAtPositionForCompletion(
 QStringList Editor::getExpressionAtPosition(
         const QSynedit::BufferCoord &pos)
 {
-    QStringList result;
     if (!syntaxer() || !parser())
-        return result;
+        return QStringList();
+    return getExpressionAtPosition(
+                document()->count(),
+                [this](int line){ return document()->getLine(line); },
+                [this](int line){ return document()->getSyntaxState(line); },
+                pos);
+}
+
+QStringList Editor::getExpressionAtPosition(
+        int lineCount,
+        const std::function<QString (int)> &lineText,
+        const std::function<QSynedit::SyntaxState (int)> &lineEndState,
+        const QSynedit::BufferCoord &pos)
+{
+    QStringList result;
     int line = pos.line-1;
     int ch = pos.ch-1;
     int symbolMatchingLevel = 0;
     LastSymbolType lastSymbolType=LastSymbolType::None;
     QSynedit::CppSyntaxer syntaxer;
     while (true) {
-        if (line>=document()->count() || line<0)
+        if (line>=lineCount || line<0)
             break;
         QStringList tokens;
         if (line==0) {
             syntaxer.resetState();
         } else {
-            syntaxer.setState(document()->getSyntaxState(line-1));
+            syntaxer.setState(lineEndState(line-1));
         }
-        QString sLine = document()->getLine(line);
+        QString sLine = lineText(line);
         syntaxer.setLine(sLine,line-1);
         while (!syntaxer.eol()) {
             int start = syntaxer.getTokenPos();
@@ -2257,7 +2282,7 @@ QStringList Editor::getExpressionAtPosition(
                 if (token==">") {
                     lastSymbolType=LastSymbolType::MatchingAngleQuotation;
                     symbolMatchingLevel=0;
-                } else if (isIdentChar(token.front())) {
+                } else if (syntaxer.isIdentChar(token.front())) {
                     lastSymbolType=LastSymbolType::Identifier;
                 } else
                     return result;
@@ -2272,7 +2297,7 @@ QStringList Editor::getExpressionAtPosition(
                 } else if (token == "]") {
                     lastSymbolType=LastSymbolType::MatchingBracket;
                     symbolMatchingLevel = 0;
-                } else if (isIdentChar(token.front())) {
+                } else if (syntaxer.isIdentChar(token.front())) {
                     lastSymbolType=LastSymbolType::Identifier;
                 } else
                     return result;
@@ -2309,7 +2334,7 @@ QStringList Editor::getExpressionAtPosition(
                     lastSymbolType=LastSymbolType::AsteriskSign;
                 } else if (token == "&") {
                     lastSymbolType=LastSymbolType::AmpersandSign;
-                } else if (isIdentChar(token.front())) {
+                } else if (syntaxer.isIdentChar(token.front())) {
                     lastSymbolType=LastSymbolType::Identifier;
                 } else
                     return result;
@@ -2321,13 +2346,13 @@ QStringList Editor::getExpressionAtPosition(
                 } else if (token == "]") {
                     lastSymbolType=LastSymbolType::MatchingBracket;
                     symbolMatchingLevel = 0;
-                } else if (isIdentChar(token.front())) {
+                } else if (syntaxer.isIdentChar(token.front())) {
                     lastSymbolType=LastSymbolType::Identifier;
                 } else
                     return result;
                 break;
             case LastSymbolType::AngleQuotationMatched: //before '<>'
-                if (isIdentChar(token.front())) {
+                if (syntaxer.isIdentChar(token.front())) {
                     lastSymbolType=LastSymbolType::Identifier;
                 } else
                     return result;
@@ -2349,7 +2374,7 @@ QStringList Editor::getExpressionAtPosition(
                 } else if (token == "]") {
                     lastSymbolType=LastSymbolType::MatchingBracket;
                     symbolMatchingLevel = 0;
-                } else if (isIdentChar(token.front())) {
+                } else if (syntaxer.isIdentChar(token.front())) {
                     lastSymbolType=LastSymbolType::Identifier;
                 } else
                     return result;
@@ -2422,7 +2447,7 @@ QStringList Editor::getExpressionAtPosition(
 
         line--;
         if (line>=0)
-            ch = document()->getLine(line).length()+1;
+            ch = lineText(line).length()+1;
     }
     return result;
 }
@@ -3119,7 +3144,10 @@ void Editor::reparse(bool resetParser)
             }
         }
     }
-    parseFile(mParser,mFilename, inProject());
+    // the file being edited goes before files parsed in the background
+    ParsePriority priority = (pMainWindow->editorList()->getEditor()==this)?
+                ParsePriority::Active : ParsePriority::Normal;
+    parseFile(mParser,mFilename, inProject(), false, true, priority);
 }
 
 void Editor::reparseTodo()
@@ -4301,7 +4329,10 @@ void Editor::updateFunctionTip(bool showTip)
     // Only do the cumbersome list filling when showing a new tooltip...
 
     if (s != pMainWindow->functionTip()->functionFullName()
-            && !mParser->parsing()) {
+            && mParser->tryFreeze()) {
+        auto action = finally([this]{
+            mParser->unFreeze();
+        });
         pMainWindow->functionTip()->clearTips();
         QList<PStatement> statements=mParser->getListOfFunctions(mFilename,
                                                                   s,
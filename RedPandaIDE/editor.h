@@ -219,6 +219,13 @@ public:
     QString getWordForCompletionSearch(const QSynedit::BufferCoord& pos,bool permitTilde);
     QStringList getExpressionAtPosition(
             const QSynedit::BufferCoord& pos);
+    // doesn't use the editor, so it can be called in worker threads.
+    // lineEndState gives the syntax state at the end of a line (starts from 0)
+    static QStringList getExpressionAtPosition(
+            int lineCount,
+            const std::function<QString (int)>& lineText,
+            const std::function<QSynedit::SyntaxState (int)>& lineEndState,
+            const QSynedit::BufferCoord& pos);
     void resetBookmarks();
 
     const PCppParser &parser() const;
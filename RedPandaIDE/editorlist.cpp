@@ -446,7 +446,8 @@ bool EditorList::getContentFromOpenedEditor(const QString &filename, QStringList
     Editor * e= getOpenedEditorByFilename(filename);
     if (!e)
         return false;
-    buffer = e->contents();
+    // called from the parser and todo threads, so don't wait for the editor's lock
+    buffer = e->document()->snapshot()->toList();
     return true;
 }
 
@@ -19,23 +19,142 @@
 #include "../utils.h"
 #include "qsynedit/syntaxer/cpp.h"
 
-#include <QApplication>
 #include <QDate>
+#include <QElapsedTimer>
 #include <QHash>
 #include <QQueue>
+#include <QReadWriteLock>
+#include <QRunnable>
 #include <QThread>
+#include <QThreadPool>
 #include <QTime>
 
 static QAtomicInt cppParserCount(0);
 
-CppParser::CppParser(QObject *parent) : QObject(parent)
+namespace {
+/**
+ * @brief Preprocesses and tokenizes a file with its own preprocessor and tokenizer,
+ * so files can be processed in the thread pool at the same time.
+ */
+class CppPreprocessTask : public QRunnable {
+public:
+    /**
+     * @param openedContents contents of the opened files, fetched before the task is started.
+     * The callback of the parser isn't called in the task, it's not safe in other threads.
+     * @param fetchedFiles files the contents are fetched for, the others are read from the disk
+     */
+    CppPreprocessTask(const QString& fileName,
+                      const CppPreprocessor& preprocessor,
+                      const QHash<QString,QStringList>& openedContents,
+                      const QSet<QString>& fetchedFiles,
+                      bool parseSystem, bool parseLocal,
+                      const QAtomicInt* cancelFlag):
+        mFileName(fileName),
+        mOpenedContents(openedContents),
+        mFetchedFiles(fetchedFiles),
+        mPreprocessTime(0),
+        mTokenizeTime(0)
+    {
+        setAutoDelete(false);
+        mPreprocessor.assignStates(preprocessor);
+        mPreprocessor.setOnGetFileStream([this](const QString& file, QStringList& buffer) {
+            auto it = mOpenedContents.constFind(file);
+            if (it != mOpenedContents.constEnd()) {
+                buffer = it.value();
+                return true;
+            }
+            if (!mFetchedFiles.contains(file))
+                mUnfetchedFiles.insert(file);
+            return false;
+        });
+        mPreprocessor.setScanOptions(parseSystem, parseLocal);
+        mPreprocessor.setCancelFlag(cancelFlag);
+        mTokenizer.setCancelFlag(cancelFlag);
+        mOldScannedFiles = mPreprocessor.scannedFiles();
+    }
+
+    void run() override {
+        QElapsedTimer timer;
+        timer.start();
+        mPreprocessor.preprocess(mFileName);
+        QStringList preprocessResult = mPreprocessor.result();
+        mContents = mPreprocessor.rootFileContents();
+        mPreprocessor.clearTempResults();
+        mPreprocessTime = timer.nsecsElapsed();
+        timer.restart();
+        mTokenizer.tokenize(preprocessResult);
+        mTokenizeTime = timer.nsecsElapsed();
+        foreach (const QString& file, mPreprocessor.scannedFiles()) {
+            if (!mOldScannedFiles.contains(file))
+                mNewScannedFiles.insert(file);
+        }
+    }
+
+    const QString& fileName() const { return mFileName; }
+    CppPreprocessor& preprocessor() { return mPreprocessor; }
+    CppTokenizer& tokenizer() { return mTokenizer; }
+    const QStringList& contents() const { return mContents; }
+    qint64 preprocessTime() const { return mPreprocessTime; }
+    qint64 tokenizeTime() const { return mTokenizeTime; }
+    // files scanned for the first time in this task (including the file itself)
+    const QSet<QString>& newScannedFiles() const { return mNewScannedFiles; }
+    // files read from the disk without knowing if they are opened
+    const QSet<QString>& unfetchedFiles() const { return mUnfetchedFiles; }
+private:
+    QString mFileName;
+    const QHash<QString,QStringList> mOpenedContents;
+    const QSet<QString> mFetchedFiles;
+    QSet<QString> mUnfetchedFiles;
+    QSet<QString> mOldScannedFiles;
+    QSet<QString> mNewScannedFiles;
+    QStringList mContents;
+    qint64 mPreprocessTime;
+    qint64 mTokenizeTime;
+    CppPreprocessor mPreprocessor;
+    CppTokenizer mTokenizer;
+};
+using PCppPreprocessTask = std::shared_ptr<CppPreprocessTask>;
+
+/**
+ * @brief Read lock of the parser states that doesn't wait for the running parse.
+ * Lookups return empty results if it's not locked.
+ */
+class StateReadLocker {
+public:
+    explicit StateReadLocker(QReadWriteLock* lock):
+        mLock(lock) {
+        mLocked = mLock->tryLockForRead();
+    }
+    ~StateReadLocker() {
+        if (mLocked)
+            mLock->unlock();
+    }
+    bool isLocked() const { return mLocked; }
+private:
+    QReadWriteLock* mLock;
+    bool mLocked;
+};
+}
+
+static QString lookupScopeKey(const PStatement& scope)
+{
+    //the lookup caches are cleared whenever statements may be freed (see clearLookupCaches())
+    return QString::number(reinterpret_cast<quintptr>(scope.get()),16);
+}
+
+CppParser::CppParser(QObject *parent) : QObject(parent),
+    mStateLock(QReadWriteLock::Recursive)
 {
     mParserId = cppParserCount.fetchAndAddRelaxed(1);
     mLanguage = ParserLanguage::CPlusPlus;
     mSerialCount = 0;
     updateSerialId();
+    mLookupCacheHits = 0;
+    mLookupCacheMisses = 0;
     mUniqId = 0;
     mParsing = false;
+    mTokenizer.setCancelFlag(&mCancelled);
+    mPreprocessor.setCancelFlag(&mCancelled);
     //mStatementList ; // owns the objects
     //mFilesToScan;
     //mIncludePaths;
@@ -46,6 +165,9 @@ CppParser::CppParser(QObject *parent) : QObject(parent)
     //mSkipList;
     mParseLocalHeaders = true;
     mParseGlobalHeaders = true;
+    mParallelParsing = false;
+    mCollectStatistics = false;
+    mLastFileId = -1;
     mLockCount = 0;
     mIsSystemHeader = false;
     mIsHeader = false;
@@ -65,19 +187,8 @@ CppParser::CppParser(QObject *parent) : QObject(parent)
 
 CppParser::~CppParser()
 {
-    while (true) {
-        //wait for all methods finishes running
-        {
-            QMutexLocker locker(&mMutex);
-            if (!mParsing && (mLockCount == 0)) {
-              mParsing = true;
-              break;
-            }
-        }
-        QThread::msleep(50);
-        QCoreApplication* app = QApplication::instance();
-        app->processEvents();
-    }
+    //wait for all methods finishes running
+    waitForParsingDone();
     //qDebug()<<"-------- parser deleted ------------";
 }
 
@@ -131,10 +242,11 @@ void CppParser::clearProjectFiles()
 
 QList<PStatement> CppParser::getListOfFunctions(const QString &fileName, const QString &phrase, int line)
 {
-    QMutexLocker locker(&mMutex);
     QList<PStatement> result;
-    if (mParsing)
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
         return result;
+    QMutexLocker locker(&mMutex);
 
     PStatement statement = doFindStatementOf(fileName,phrase, line);
     if (!statement)
@@ -161,10 +273,10 @@ QList<PStatement> CppParser::getListOfFunctions(const QString &fileName, const Q
 
 PStatement CppParser::findScopeStatement(const QString &filename, int line)
 {
-    QMutexLocker locker(&mMutex);
-    if (mParsing) {
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
         return PStatement();
-    }
+    QMutexLocker locker(&mMutex);
     return doFindScopeStatement(filename,line);
 }
 
@@ -187,17 +299,19 @@ PFileIncludes CppParser::findFileIncludes(const QString &filename, bool deleteIt
 }
 QString CppParser::findFirstTemplateParamOf(const QString &fileName, const QString &phrase, const PStatement& currentScope)
 {
-    QMutexLocker locker(&mMutex);
-    if (mParsing)
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
         return "";
+    QMutexLocker locker(&mMutex);
     return doFindFirstTemplateParamOf(fileName,phrase,currentScope);
 }
 
 QString CppParser::findTemplateParamOf(const QString &fileName, const QString &phrase, int index, const PStatement &currentScope)
 {
-    QMutexLocker locker(&mMutex);
-    if (mParsing)
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
         return "";
+    QMutexLocker locker(&mMutex);
     return doFindTemplateParamOf(fileName,phrase,index,currentScope);
 }
 
@@ -285,10 +399,21 @@ PStatement CppParser::doFindStatement(const QString &fullname) const
 
 PStatement CppParser::findStatementOf(const QString &fileName, const QString &phrase, int line)
 {
-    QMutexLocker locker(&mMutex);
-    if (mParsing)
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
         return PStatement();
-    return doFindStatementOf(fileName,phrase,line);
+    QMutexLocker locker(&mMutex);
+    prepareLookupCache();
+    QString key = QString("P\n%1\n%2\n%3").arg(fileName,QString::number(line),phrase);
+    auto it = mStatementLookupCache.constFind(key);
+    if (it!=mStatementLookupCache.constEnd()) {
+        mLookupCacheHits++;
+        return it.value();
+    }
+    mLookupCacheMisses++;
+    PStatement statement = doFindStatementOf(fileName,phrase,line);
+    mStatementLookupCache.insert(key,statement);
+    return statement;
 }
 PStatement CppParser::doFindStatementOf(const QString &fileName, const QString &phrase, int line) const
 {
@@ -300,9 +425,10 @@ PStatement CppParser::findStatementOf(const QString &fileName,
                                       const PStatement& currentScope,
                                       PStatement &parentScopeType)
 {
-    QMutexLocker locker(&mMutex);
-    if (mParsing)
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
         return PStatement();
+    QMutexLocker locker(&mMutex);
     return doFindStatementOf(fileName,phrase,currentScope,parentScopeType);
 }
 
@@ -470,17 +596,31 @@ PEvalStatement CppParser::evalExpression(
         QStringList &phraseExpression,
         const PStatement &currentScope)
 {
-    QMutexLocker locker(&mMutex);
-    if (mParsing)
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
         return PEvalStatement();
+    QMutexLocker locker(&mMutex);
 //    qDebug()<<phraseExpression;
+    prepareLookupCache();
+    QString key = QString("%1\n%2\n%3").arg(fileName,
+                                            lookupScopeKey(currentScope),
+                                            phraseExpression.join('\n'));
+    auto it = mEvalLookupCache.constFind(key);
+    if (it!=mEvalLookupCache.constEnd()) {
+        mLookupCacheHits++;
+        //callers may change the result, don't give them the cached one
+        return it.value()?std::make_shared<EvalStatement>(*it.value()):PEvalStatement();
+    }
+    mLookupCacheMisses++;
     int pos = 0;
-    return doEvalExpression(fileName,
+    PEvalStatement result = doEvalExpression(fileName,
                             phraseExpression,
                             pos,
                             currentScope,
                             PEvalStatement(),
                             true);
+    mEvalLookupCache.insert(key,result?std::make_shared<EvalStatement>(*result):PEvalStatement());
+    return result;
 }
 
 PStatement CppParser::doFindStatementOf(const QString &fileName, const QString &phrase, const PStatement& currentClass) const
@@ -492,10 +632,23 @@ PStatement CppParser::doFindStatementOf(const QString &fileName, const QString &
 
 PStatement CppParser::findStatementOf(const QString &fileName, const QStringList &expression, const PStatement &currentScope)
 {
-    QMutexLocker locker(&mMutex);
-    if (mParsing)
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
         return PStatement();
-    return doFindStatementOf(fileName,expression,currentScope);
+    QMutexLocker locker(&mMutex);
+    prepareLookupCache();
+    QString key = QString("S\n%1\n%2\n%3").arg(fileName,
+                                               lookupScopeKey(currentScope),
+                                               expression.join('\n'));
+    auto it = mStatementLookupCache.constFind(key);
+    if (it!=mStatementLookupCache.constEnd()) {
+        mLookupCacheHits++;
+        return it.value();
+    }
+    mLookupCacheMisses++;
+    PStatement statement = doFindStatementOf(fileName,expression,currentScope);
+    mStatementLookupCache.insert(key,statement);
+    return statement;
 }
 
 PStatement CppParser::doFindStatementOf(const QString &fileName, const QStringList &expression, const PStatement &currentScope) const
@@ -562,10 +715,38 @@ PStatement CppParser::doFindStatementOf(const QString &fileName, const QStringLi
 
 PStatement CppParser::findStatementOf(const QString &fileName, const QStringList &expression, int line)
 {
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
+        return PStatement();
     QMutexLocker locker(&mMutex);
-    if (mParsing)
+    return cachedFindStatementOf(fileName,expression,line);
+}
+
+PStatement CppParser::findStatementOfWhileFrozen(const QString &fileName, const QStringList &expression, int line)
+{
+    // Taking the read lock again here would wait behind the parse queued for the write lock,
+    // and that parse waits for the freeze to be released.
+    // The freeze already keeps the states from being changed.
+    QMutexLocker locker(&mMutex);
+    Q_ASSERT(mLockCount>0);
+    if (mLockCount<=0)
         return PStatement();
-    return doFindStatementOf(fileName,expression,line);
+    return cachedFindStatementOf(fileName,expression,line);
+}
+
+PStatement CppParser::cachedFindStatementOf(const QString &fileName, const QStringList &expression, int line)
+{
+    prepareLookupCache();
+    QString key = QString("L\n%1\n%2\n%3").arg(fileName,QString::number(line),expression.join('\n'));
+    auto it = mStatementLookupCache.constFind(key);
+    if (it!=mStatementLookupCache.constEnd()) {
+        mLookupCacheHits++;
+        return it.value();
+    }
+    mLookupCacheMisses++;
+    PStatement statement = doFindStatementOf(fileName,expression,line);
+    mStatementLookupCache.insert(key,statement);
+    return statement;
 }
 
 PStatement CppParser::doFindStatementOf(const QString &fileName, const QStringList &expression, int line) const
@@ -584,11 +765,33 @@ PStatement CppParser::doFindStatementOf(const QString &fileName, const QStringLi
 
 PStatement CppParser::findAliasedStatement(const PStatement &statement)
 {
-    QMutexLocker locker(&mMutex);
-    if (mParsing)
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
         return PStatement();
+    QMutexLocker locker(&mMutex);
     return doFindAliasedStatement(statement);
 }
+StatementMap CppParser::getInheritedMembers(const PStatement &classStatement)
+{
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
+        return StatementMap();
+    QMutexLocker locker(&mMutex);
+    return doGetInheritedMembers(classStatement);
+}
+
+PFileSemanticTokens CppParser::semanticTokens(const QString &fileName)
+{
+    QMutexLocker locker(&mMutex);
+    return mSemanticTokens.value(fileName);
+}
+
+PFileReferences CppParser::references(const QString &fileName)
+{
+    QMutexLocker locker(&mMutex);
+    return mReferences.value(fileName);
+}
+
 PStatement CppParser::doFindAliasedStatement(const PStatement &statement) const
 {
     if (!statement)
@@ -651,39 +854,51 @@ PStatement CppParser::findStatementStartingFrom(const QString &fileName, const Q
 
 PStatement CppParser::findTypeDefinitionOf(const QString &fileName, const QString &aType, const PStatement& currentClass)
 {
-    QMutexLocker locker(&mMutex);
-
-    if (mParsing)
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
         return PStatement();
+    QMutexLocker locker(&mMutex);
 
     return doFindTypeDefinitionOf(fileName,aType,currentClass);
 }
 
 PStatement CppParser::findTypeDef(const PStatement &statement, const QString &fileName)
 {
-    QMutexLocker locker(&mMutex);
-
-    if (mParsing)
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
         return PStatement();
+    QMutexLocker locker(&mMutex);
     return getTypeDef(statement, fileName, "");
 }
 
 bool CppParser::freeze()
 {
-    QMutexLocker locker(&mMutex);
-    if (mParsing)
+    // wait a little for the parser to finish the file it's working on
+    if (!mStateLock.tryLockForRead(FREEZE_WAIT_TIMEOUT))
         return false;
+    QMutexLocker locker(&mMutex);
     mLockCount++;
     return true;
 }
 
 bool CppParser::freeze(const QString &serialId)
 {
+    if (!mStateLock.tryLockForRead(FREEZE_WAIT_TIMEOUT))
+        return false;
     QMutexLocker locker(&mMutex);
-    if (mParsing)
+    if (mSerialId!=serialId) {
+        mStateLock.unlock();
         return false;
-    if (mSerialId!=serialId)
+    }
+    mLockCount++;
+    return true;
+}
+
+bool CppParser::tryFreeze()
+{
+    if (!mStateLock.tryLockForRead())
         return false;
+    QMutexLocker locker(&mMutex);
     mLockCount++;
     return true;
 }
@@ -703,7 +918,7 @@ QStringList CppParser::getClassesList()
         for (PStatement& child:statementMap) {
             if (child->kind == StatementKind::skClass)
                 list.append(child->command);
-            if (!child->children.isEmpty())
+            if (!mStatementList.childrenStatements(child).isEmpty())
                 queue.enqueue(child);
         }
     }
@@ -712,9 +927,10 @@ QStringList CppParser::getClassesList()
 
 QStringList CppParser::getFileDirectIncludes(const QString &filename)
 {
-    QMutexLocker locker(&mMutex);
-    if (mParsing)
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
         return QStringList();
+    QMutexLocker locker(&mMutex);
     if (filename.isEmpty())
         return QStringList();
     PFileIncludes fileIncludes = mPreprocessor.includesList().value(filename,PFileIncludes());
@@ -728,10 +944,11 @@ QStringList CppParser::getFileDirectIncludes(const QString &filename)
 
 QSet<QString> CppParser::getFileIncludes(const QString &filename)
 {
-    QMutexLocker locker(&mMutex);
     QSet<QString> list;
-    if (mParsing)
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
         return list;
+    QMutexLocker locker(&mMutex);
     if (filename.isEmpty())
         return list;
     list.insert(filename);
@@ -745,6 +962,22 @@ QSet<QString> CppParser::getFileIncludes(const QString &filename)
     return list;
 }
 
+FileIdSet CppParser::getFileIncludeIds(const QString &filename)
+{
+    FileIdSet ids;
+    StateReadLocker stateLocker(&mStateLock);
+    if (!stateLocker.isLocked())
+        return ids;
+    QMutexLocker locker(&mMutex);
+    if (filename.isEmpty())
+        return ids;
+    PFileIncludes fileIncludes = mPreprocessor.includesList().value(filename,PFileIncludes());
+    if (fileIncludes)
+        ids = fileIncludes->includeFileIds;
+    ids.insert(FileIdTable::idOf(filename));
+    return ids;
+}
+
 QSet<QString> CppParser::getFileUsings(const QString &filename)
 {
     QMutexLocker locker(&mMutex);
@@ -821,7 +1054,7 @@ void CppParser::invalidateFile(const QString &fileName)
     }
     QSet<QString> files = calculateFilesToBeReparsed(fileName);
     internalInvalidateFiles(files);
-    mParsing = false;
+    setParsingDone();
 }
 
 bool CppParser::isIncludeLine(const QString &line)
@@ -858,23 +1091,25 @@ bool CppParser::isSystemHeaderFile(const QString &fileName)
     return ::isSystemHeaderFile(fileName,mPreprocessor.includePaths());
 }
 
-void CppParser::parseFile(const QString &fileName, bool inProject, bool onlyIfNotParsed, bool updateView)
+bool CppParser::parseFile(const QString &fileName, bool inProject, bool onlyIfNotParsed, bool updateView)
 {
     if (!mEnabled)
-        return;
+        return true;
     {
         QMutexLocker locker(&mMutex);
-        if (mParsing || mLockCount>0)
-            return;
+        if (mParsing)
+            return false;
         updateSerialId();
         mParsing = true;
+        mCancelled.storeRelease(0);
         if (updateView)
             emit onBusy();
         emit onStartParsing();
     }
     {
         auto action = finally([&,this]{
-            mParsing = false;
+            updateSystemHeaderSymbols();
+            setParsingDone();
 
             if (updateView)
                 emit onEndParsing(mFilesScannedCount,1);
@@ -883,31 +1118,39 @@ void CppParser::parseFile(const QString &fileName, bool inProject, bool onlyIfNo
         });
         QString fName = fileName;
         if (onlyIfNotParsed && mPreprocessor.scannedFiles().contains(fName))
-            return;
+            return true;
+
+        // only a function body is changed, other files are not affected
+        if (internalParseIncrementally(fileName)) {
+            mFilesToScanCount = 1;
+            mFilesScannedCount = 1;
+            emit onProgress(fileName,mFilesToScanCount,mFilesScannedCount);
+            updateSemanticTokens(QStringList{fileName});
+            return true;
+        }
 
-        if (inProject) {
-            QSet<QString> filesToReparsed = calculateFilesToBeReparsed(fileName);
+        QSet<QString> filesToReparsed;
+        if (inProject)
+            filesToReparsed = calculateFilesToBeReparsed(fileName);
+        if (filesToReparsed.count()>1) {
             QStringList files = sortFilesByIncludeRelations(filesToReparsed);
             internalInvalidateFiles(filesToReparsed);
 
             mFilesToScanCount = files.count();
             mFilesScannedCount = 0;
 
-            foreach (const QString& file,files) {
-                mFilesScannedCount++;
-                emit onProgress(file,mFilesToScanCount,mFilesScannedCount);
-                if (!mPreprocessor.scannedFiles().contains(file)) {
-                    internalParse(file);
-                }
-            }
+            internalParseFiles(files);
+            updateSemanticTokens(files);
         } else {
-            internalInvalidateFile(fileName);
             mFilesToScanCount = 1;
             mFilesScannedCount = 0;
 
             mFilesScannedCount++;
             emit onProgress(fileName,mFilesToScanCount,mFilesScannedCount);
-            internalParse(fileName);
+            // invalidated when its new statements are built
+            internalParse(fileName, true);
+            dropReferencesOfDependents(fileName);
+            updateSemanticTokens(QStringList{fileName});
         }
 
 //        if (inProject)
@@ -919,25 +1162,29 @@ void CppParser::parseFile(const QString &fileName, bool inProject, bool onlyIfNo
         // Parse from disk or stream
 
     }
+    return true;
 }
 
-void CppParser::parseFileList(bool updateView)
+bool CppParser::parseFileList(bool updateView)
 {
     if (!mEnabled)
-        return;
+        return true;
     {
         QMutexLocker locker(&mMutex);
-        if (mParsing || mLockCount>0)
-            return;
+        if (mParsing)
+            return false;
         updateSerialId();
         mParsing = true;
+        mCancelled.storeRelease(0);
         if (updateView)
             emit onBusy();
         emit onStartParsing();
     }
     {
         auto action = finally([&,this]{
-            mParsing = false;
+            updateSystemHeaderSymbols();
+            mStringPool.squeeze();
+            setParsingDone();
             if (updateView)
                 emit onEndParsing(mFilesScannedCount,1);
             else
@@ -949,19 +1196,18 @@ void CppParser::parseFileList(bool updateView)
 
         QStringList files = sortFilesByIncludeRelations(mFilesToScan);
         // parse header files in the first parse
-        foreach (const QString& file, files) {
-            mFilesScannedCount++;
-            emit onProgress(mCurrentFile,mFilesToScanCount,mFilesScannedCount);
-            if (!mPreprocessor.scannedFiles().contains(file)) {
-                internalParse(file);
-            }
-        }
-        mFilesToScan.clear();
+        internalParseFiles(files);
+        updateSemanticTokens(files);
+        // files left by a cancelled parse are parsed next time
+        if (!isCancelled())
+            mFilesToScan.clear();
     }
+    return true;
 }
 
 void CppParser::parseHardDefines()
 {
+    QWriteLocker stateLocker(&mStateLock);
     QMutexLocker locker(&mMutex);
     if (mParsing)
         return;
@@ -970,7 +1216,9 @@ void CppParser::parseHardDefines()
     mParsing=true;
     {
         auto action = finally([&,this]{
+            updateSerialId();
             mParsing = false;
+            mParsingDone.wakeAll();
             mIsSystemHeader=oldIsSystemHeader;
         });
         for (const PDefine& define:mPreprocessor.hardDefines()) {
@@ -996,23 +1244,18 @@ bool CppParser::parsing() const
     return mParsing;
 }
 
+void CppParser::cancelParsing()
+{
+    mCancelled.storeRelease(1);
+}
+
 void CppParser::resetParser()
 {
-    while (true) {
-        {
-            QMutexLocker locker(&mMutex);
-            if (!mParsing && mLockCount ==0) {
-                mParsing = true;
-                break;
-            }
-        }
-        QThread::msleep(50);
-        QCoreApplication* app = QApplication::instance();
-        app->processEvents();
-    }
+    waitForParsingDone();
     {
+        QWriteLocker stateLocker(&mStateLock);
         auto action = finally([this]{
-            mParsing = false;
+            setParsingDone();
         });
         emit  onBusy();
         mUniqId = 0;
@@ -1036,6 +1279,17 @@ void CppParser::resetParser()
         mFilesToScan.clear(); // list of base files to scan
         mNamespaces.clear();  // namespace and the statements in its scope
         mInlineNamespaces.clear();
+        mSystemHeaderCacheFile.clear();
+        mSystemHeaderCacheKey.clear();
+        mCachedSystemHeaders.clear();
+        mSystemHeaderSymbols.reset();
+        mParsedFileContents.clear();
+        {
+            QMutexLocker locker(&mMutex);
+            mSemanticTokens.clear();
+            mReferences.clear();
+        }
+        mStringPool.clear();
 
         mPreprocessor.clear();
         mTokenizer.clear();
@@ -1043,10 +1297,52 @@ void CppParser::resetParser()
     }
 }
 
-void CppParser::unFreeze()
+void CppParser::setSystemHeaderCache(const QString &compilerSetId, const QString &cacheFolder)
 {
+    QWriteLocker stateLocker(&mStateLock);
     QMutexLocker locker(&mMutex);
-    mLockCount--;
+    if (mParsing)
+        return;
+    mParsing = true;
+    auto action = finally([this]{
+        updateSerialId();
+        mParsing = false;
+        mParsingDone.wakeAll();
+    });
+    mCachedSystemHeaders.clear();
+    mSystemHeaderSymbols.reset();
+    mSystemHeaderCacheFile.clear();
+    mSystemHeaderCacheKey.clear();
+    if (compilerSetId.isEmpty())
+        return;
+    mSystemHeaderCacheKey = SystemHeaderCache::calcKey(
+                compilerSetId,
+                mLanguage,
+                mPreprocessor.includePathList(),
+                mPreprocessor.hardDefines());
+    if (!cacheFolder.isEmpty())
+        mSystemHeaderCacheFile = SystemHeaderCache::cacheFileName(cacheFolder,mSystemHeaderCacheKey);
+    //symbols can only be loaded into a freshly reset parser
+    if (!mPreprocessor.scannedFiles().isEmpty())
+        return;
+    //prefer the snapshot already used by other parsers
+    PSystemHeaderSymbols symbols = SystemHeaderCache::sharedSymbols(mSystemHeaderCacheKey);
+    if (!symbols && !mSystemHeaderCacheFile.isEmpty()) {
+        symbols = SystemHeaderCache::load(mSystemHeaderCacheFile,mSystemHeaderCacheKey);
+        SystemHeaderCache::shareSymbols(symbols);
+    }
+    if (symbols)
+        loadSystemHeaderSymbols(symbols);
+}
+
+void CppParser::unFreeze()
+{
+    {
+        QMutexLocker locker(&mMutex);
+        mLockCount--;
+        mParsingDone.wakeAll();
+    }
+    mStateLock.unlock();
 }
 
 QSet<QString> CppParser::scannedFiles()
@@ -1209,25 +1505,6 @@ void CppParser::addProjectFile(const QString &fileName, bool needScan)
     }
 }
 
-PStatement CppParser::addInheritedStatement(const PStatement& derived, const PStatement& inherit, StatementAccessibility access)
-{
-
-    PStatement statement = addStatement(
-                derived,
-                inherit->fileName,
-                inherit->type, // "Type" is already in use
-                inherit->command,
-                inherit->args,
-                inherit->noNameArgs,
-                inherit->value,
-                inherit->line,
-                inherit->kind,
-                inherit->scope,
-                access,
-                inherit->properties & StatementProperty::spInherited);
-    return statement;
-}
-
 PStatement CppParser::addChildStatement(const PStatement& parent, const QString &fileName,
                                         const QString &aType,
                                         const QString &command, const QString &args,
@@ -1251,6 +1528,16 @@ PStatement CppParser::addChildStatement(const PStatement& parent, const QString
                 properties);
 }
 
+int CppParser::fileIdOf(const QString &fileName)
+{
+    //statements are added file by file, so cache the last query
+    if (fileName!=mLastFileIdName) {
+        mLastFileIdName = fileName;
+        mLastFileId = FileIdTable::idOf(fileName);
+    }
+    return mLastFileId;
+}
+
 PStatement CppParser::addStatement(const PStatement& parent,
                                    const QString &fileName,
                                    const QString &aType,
@@ -1282,7 +1569,8 @@ PStatement CppParser::addStatement(const PStatement& parent,
         //find
         if (properties.testFlag(StatementProperty::spHasDefinition)) {
             PStatement oldStatement = findStatementInScope(newCommand,noNameArgs,kind,parent);
-            if (oldStatement  && !oldStatement->hasDefinition()) {
+            //statements shared with other parsers are read-only
+            if (oldStatement  && !oldStatement->hasDefinition() && !oldStatement->isShared()) {
                 oldStatement->setHasDefinition(true);
                 if (oldStatement->fileName!=fileName) {
                     PFileIncludes fileIncludes=mPreprocessor.includesList().value(fileName);
@@ -1292,22 +1580,23 @@ PStatement CppParser::addStatement(const PStatement& parent,
                     }
                 }
                 oldStatement->definitionLine = line;
-                oldStatement->definitionFileName = fileName;
+                oldStatement->definitionFileName = mStringPool.intern(fileName);
+                oldStatement->definitionFileId = fileIdOf(fileName);
                 return oldStatement;
             }
         }
     }
     PStatement result = std::make_shared<Statement>();
     result->parentScope = parent;
-    result->type = newType;
+    result->type = mStringPool.intern(newType);
     if (!newCommand.isEmpty())
-        result->command = newCommand;
+        result->command = mStringPool.intern(newCommand);
     else {
         mUniqId++;
         result->command = QString("__STATEMENT__%1").arg(mUniqId);
     }
-    result->args = args;
-    result->noNameArgs = noNameArgs;
+    result->args = mStringPool.intern(args);
+    result->noNameArgs = mStringPool.intern(noNameArgs);
     result->value = value;
     result->kind = kind;
     result->scope = scope;
@@ -1315,8 +1604,10 @@ PStatement CppParser::addStatement(const PStatement& parent,
     result->properties = properties;
     result->line = line;
     result->definitionLine = line;
-    result->fileName = fileName;
-    result->definitionFileName = fileName;
+    result->fileName = mStringPool.intern(fileName);
+    result->definitionFileName = result->fileName;
+    result->fileId = fileIdOf(fileName);
+    result->definitionFileId = result->fileId;
     if (!fileName.isEmpty()) {
         result->setInProject(mIsProjectFile);
         result->setInSystemHeader(mIsSystemHeader);
@@ -1333,12 +1624,7 @@ PStatement CppParser::addStatement(const PStatement& parent,
     result->usageCount = -1;
     mStatementList.add(result);
     if (result->kind == StatementKind::skNamespace) {
-        PStatementList namespaceList = mNamespaces.value(result->fullName,PStatementList());
-        if (!namespaceList) {
-            namespaceList=std::make_shared<StatementList>();
-            mNamespaces.insert(result->fullName,namespaceList);
-        }
-        namespaceList->append(result);
+        addNamespaceStatement(result);
     }
 
     if (result->kind!= StatementKind::skBlock) {
@@ -1621,16 +1907,115 @@ void CppParser::internalClear()
     mInlineNamespaceEndSkips.clear();
 }
 
+void CppParser::addNamespaceStatement(const PStatement &namespaceStatement)
+{
+    PStatementList namespaceList = mNamespaces.value(namespaceStatement->fullName,PStatementList());
+    if (!namespaceList) {
+        namespaceList=std::make_shared<StatementList>();
+        mNamespaces.insert(namespaceStatement->fullName,namespaceList);
+    }
+    namespaceList->append(namespaceStatement);
+}
+
+void CppParser::loadSystemHeaderSymbols(const PSystemHeaderSymbols &symbols)
+{
+    mSystemHeaderSymbols = symbols;
+    foreach (const PStatement& statement, symbols->statements) {
+        //children are already linked to their parents in the snapshot,
+        //unless the parents are from an older snapshot
+        PStatement parent = statement->parentScope.lock();
+        if (!parent || !parent->children.contains(statement->command,statement))
+            mStatementList.add(statement);
+        if (statement->kind == StatementKind::skNamespace)
+            addNamespaceStatement(statement);
+    }
+    for (auto it=symbols->includes.constBegin();it!=symbols->includes.constEnd();++it) {
+        mPreprocessor.includesList().insert(it.key(),it.value());
+        mPreprocessor.includeGraph().setIncludes(it.key(),it.value()->includeFiles.keys());
+        mPreprocessor.scannedFiles().insert(it.key());
+    }
+    for (auto it=symbols->defines.constBegin();it!=symbols->defines.constEnd();++it) {
+        mPreprocessor.addFileDefines(it.key(),it.value());
+    }
+    mInlineNamespaces.unite(symbols->inlineNamespaces);
+    foreach (const QString& header, symbols->timestamps.keys()) {
+        mCachedSystemHeaders.insert(header);
+    }
+}
+
+PSystemHeaderSymbols CppParser::collectSystemHeaderSymbols(const QSet<QString> &headers) const
+{
+    PSystemHeaderSymbols symbols = std::make_shared<SystemHeaderSymbols>();
+    symbols->key = mSystemHeaderCacheKey;
+    foreach (const QString& header, headers) {
+        symbols->timestamps.insert(header,SystemHeaderCache::fileTimestamp(header));
+        PFileIncludes fileIncludes = mPreprocessor.includesList().value(header);
+        if (fileIncludes)
+            symbols->includes.insert(header,fileIncludes);
+        PDefineMap defines = mPreprocessor.fileDefines().value(header);
+        if (defines)
+            symbols->defines.insert(header,defines);
+    }
+    //parents must be collected before their children
+    QQueue<PStatement> queue;
+    queue.enqueue(PStatement());
+    while (!queue.isEmpty()) {
+        PStatement statement = queue.dequeue();
+        const StatementMap& statementMap = mStatementList.childrenStatements(statement);
+        foreach (const PStatement& child, statementMap) {
+            if (!headers.contains(child->fileName))
+                continue;
+            symbols->statements.append(child);
+            if (!mStatementList.childrenStatements(child).isEmpty())
+                queue.enqueue(child);
+        }
+    }
+    symbols->inlineNamespaces = mInlineNamespaces;
+    return symbols;
+}
+
+void CppParser::updateSystemHeaderSymbols()
+{
+    if (mSystemHeaderCacheKey.isEmpty())
+        return;
+    QSet<QString> headers;
+    bool changed = false;
+    foreach (const QString& file, mPreprocessor.scannedFiles()) {
+        if (mCachedSystemHeaders.contains(file)) {
+            headers.insert(file);
+        } else if (!mProjectFiles.contains(file)
+                   && ::isSystemHeaderFile(file,mPreprocessor.includePaths())) {
+            headers.insert(file);
+            changed = true;
+        }
+    }
+    if (!changed)
+        return;
+    PSystemHeaderSymbols symbols = collectSystemHeaderSymbols(headers);
+    {
+        QWriteLocker stateLocker(&mStateLock);
+        //from now on these statements are shared with other parsers
+        foreach (const PStatement& statement, symbols->statements) {
+            mStatementList.shareStatement(statement, headers);
+        }
+        mSystemHeaderSymbols = symbols;
+        mCachedSystemHeaders = headers;
+    }
+    SystemHeaderCache::shareSymbols(symbols);
+    if (!mSystemHeaderCacheFile.isEmpty())
+        SystemHeaderCache::save(mSystemHeaderCacheFile,symbols);
+}
+
 QStringList CppParser::sortFilesByIncludeRelations(const QSet<QString> &files)
 {
-    QStringList result;
     QSet<QString> saveScannedFiles;
 
     saveScannedFiles=mPreprocessor.scannedFiles();
 
-    //rebuild file include relations
+    //get include relations of files that have never been scanned
     foreach(const QString& file, files) {
-        if (mPreprocessor.scannedFiles().contains(file))
+        if (mPreprocessor.scannedFiles().contains(file)
+                || mPreprocessor.includeGraph().contains(file))
             continue;
         //already removed in interalInvalidateFiles
         //mPreprocessor.removeScannedFile(file);
@@ -1640,32 +2025,7 @@ QStringList CppParser::sortFilesByIncludeRelations(const QSet<QString> &files)
         mPreprocessor.clearTempResults();
     }
 
-    QSet<QString> fileSet=files;
-    while (!fileSet.isEmpty()) {
-        bool found=false;
-        foreach (const QString& file,fileSet) {
-            PFileIncludes fileIncludes = mPreprocessor.includesList().value(file);
-            bool hasInclude=false;
-            foreach(const QString& inc,fileIncludes->includeFiles.keys()) {
-                if (fileSet.contains(inc)) {
-                    hasInclude=true;
-                    break;
-                }
-            }
-            if (!hasInclude) {
-                result.push_front(file);
-                fileSet.remove(file);
-                found=true;
-                break;
-            }
-        }
-        if (!found) {
-            foreach (const QString& file,fileSet) {
-                result.push_front(file);
-                fileSet.remove(file);
-            }
-        }
-    }
+    QStringList result = mPreprocessor.includeGraph().sortByIncludeRelations(files);
     QSet<QString> newScannedFiles = mPreprocessor.scannedFiles();
     foreach(const QString& file, newScannedFiles) {
         if (!saveScannedFiles.contains(file))
@@ -1676,7 +2036,7 @@ QStringList CppParser::sortFilesByIncludeRelations(const QSet<QString> &files)
 
 bool CppParser::checkForKeyword(KeywordType& keywordType)
 {
-    keywordType = mCppKeywords.value(mTokenizer[mIndex]->text,KeywordType::NotKeyword);
+    keywordType = mTokenizer[mIndex]->keyword;
     switch(keywordType) {
     case KeywordType::Catch:
     case KeywordType::For:
@@ -1746,7 +2106,7 @@ bool CppParser::checkForStructs(KeywordType keywordType)
             mIndex++;
             return false;
         }
-        result = (mCppKeywords.value(mTokenizer[mIndex+dis]->text,KeywordType::None)==KeywordType::Struct);
+        result = (mTokenizer[mIndex+dis]->keyword==KeywordType::Struct);
     } else {
         result = (keywordType==KeywordType::Struct);
     }
@@ -1807,7 +2167,7 @@ bool CppParser::checkForTypedefStruct()
     //should call CheckForTypedef first!!!
     if (mIndex+1 >= mTokenizer.tokenCount())
         return false;
-    return (mCppKeywords.value(mTokenizer[mIndex+1]->text,KeywordType::None)==KeywordType::Struct);
+    return (mTokenizer[mIndex+1]->keyword==KeywordType::Struct);
 
 }
 
@@ -4018,7 +4378,7 @@ void CppParser::handleVar(const QString& typePrefix,bool isExtern,bool isStatic)
     mIndex++;
 }
 
-void CppParser::internalParse(const QString &fileName)
+void CppParser::internalParse(const QString &fileName, bool reparse)
 {
     // Perform some validation before we start
     if (!mEnabled)
@@ -4026,55 +4386,556 @@ void CppParser::internalParse(const QString &fileName)
 //    if (!isCfile(fileName) && !isHfile(fileName))  // support only known C/C++ files
 //        return;
 
-    //QElapsedTimer timer;
+    // The file is preprocessed and tokenized with a private preprocessor/tokenizer,
+    // lookups are only blocked while the statements are built.
+    // States of mPreprocessor are only changed by the parsing thread (this one).
+    QElapsedTimer timer;
+    CppPreprocessor preprocessor;
+    CppTokenizer tokenizer;
+    preprocessor.assignStates(mPreprocessor);
+    preprocessor.setScanOptions(mParseGlobalHeaders, mParseLocalHeaders);
+    preprocessor.setCancelFlag(&mCancelled);
+    tokenizer.setCancelFlag(&mCancelled);
+    if (reparse)
+        preprocessor.removeScannedFile(fileName);
+    QSet<QString> oldScannedFiles = preprocessor.scannedFiles();
+    timer.start();
     // Preprocess the file...
-    auto action = finally([this]{
-        mTokenizer.clear();
-    });
-    //timer.start();
-    // Let the preprocessor augment the include records
-    mPreprocessor.setScanOptions(mParseGlobalHeaders, mParseLocalHeaders);
-    mPreprocessor.preprocess(fileName);
+    preprocessor.preprocess(fileName);
+    // nothing is changed yet
+    if (isCancelled())
+        return;
 
-    QStringList preprocessResult = mPreprocessor.result();
+    QStringList preprocessResult = preprocessor.result();
+    QStringList contents = preprocessor.rootFileContents();
 #ifdef QT_DEBUG
-//        stringsToFile(mPreprocessor.result(),QString("r:\\preprocess-%1.txt").arg(extractFileName(fileName)));
-//        mPreprocessor.dumpDefinesTo("r:\\defines.txt");
-//        mPreprocessor.dumpIncludesListTo("r:\\includes.txt");
+//        stringsToFile(preprocessor.result(),QString("r:\\preprocess-%1.txt").arg(extractFileName(fileName)));
+//        preprocessor.dumpDefinesTo("r:\\defines.txt");
+//        preprocessor.dumpIncludesListTo("r:\\includes.txt");
 #endif
-    //qDebug()<<"preprocess"<<timer.elapsed();
     //reduce memory usage
-    //timer.restart();
-    mPreprocessor.clearTempResults();
-    //qDebug()<<"preprocess clean"<<timer.elapsed();
+    preprocessor.clearTempResults();
+    qint64 preprocessTime = timer.nsecsElapsed();
 
-    //timer.restart();
+    timer.restart();
     // Tokenize the preprocessed buffer file
-    mTokenizer.tokenize(preprocessResult);
+    tokenizer.tokenize(preprocessResult);
     //reduce memory usage
     preprocessResult.clear();
-    //qDebug()<<"tokenize"<<timer.elapsed();
-    if (mTokenizer.tokenCount() == 0)
+    qint64 tokenizeTime = timer.nsecsElapsed();
+    if (isCancelled())
         return;
+    QSet<QString> newScannedFiles;
+    foreach (const QString& file, preprocessor.scannedFiles()) {
+        if (!oldScannedFiles.contains(file))
+            newScannedFiles.insert(file);
+    }
+
+    // readers never see the file half-updated
+    QWriteLocker stateLocker(&mStateLock);
+    //statements and members of the classes may be changed
+    {
+        QMutexLocker locker(&mMutex);
+        clearLookupCaches();
+    }
+    if (reparse)
+        internalInvalidateFile(fileName);
+    QSet<QString> oldParsedFiles = mPreprocessor.scannedFiles();
+    // Let the preprocessor augment the include records
+    mPreprocessor.addScannedFiles(preprocessor, newScannedFiles);
+    // keep contents of the opened file for incremental parsing
+    if (!contents.isEmpty())
+        mParsedFileContents.insert(fileName,contents);
+    else
+        mParsedFileContents.remove(fileName);
+    auto action = finally([this]{
+        mTokenizer.clear();
+    });
+    mTokenizer.swap(tokenizer);
+    int tokenCount = mTokenizer.tokenCount();
+    int oldStatementCount = mStatementList.count();
+    timer.restart();
+    if (mTokenizer.tokenCount() > 0) {
 #ifdef QT_DEBUG
 //       mTokenizer.dumpTokens(QString("r:\\tokens-%1.txt").arg(extractFileName(fileName)));
 #endif
-#ifdef QT_DEBUG
-        mLastIndex = -1;
-#endif
-    //    timer.restart();
-    // Process the token list
-    while(true) {
-        if (!handleStatement())
-            break;
+        parseTokens();
     }
-    //    qDebug()<<"parse"<<timer.elapsed();
-#ifdef QT_DEBUG
-//        mStatementList.dumpAll(QString("r:\\all-stats-%1.txt").arg(extractFileName(fileName)));
-//        mStatementList.dump(QString("r:\\stats-%1.txt").arg(extractFileName(fileName)));
-#endif
-    //reduce memory usage
-    internalClear();
+    if (isCancelled()) {
+        discardCancelledParse(oldParsedFiles);
+        return;
+    }
+    if (mCollectStatistics)
+        mStatistics.append(FileParseStatistics{fileName, preprocessTime, tokenizeTime,
+                                               timer.nsecsElapsed(), tokenCount,
+                                               mStatementList.count()-oldStatementCount});
+}
+
+bool CppParser::isCancelled() const
+{
+    return mCancelled.loadAcquire();
+}
+
+void CppParser::discardCancelledParse(const QSet<QString> &oldScannedFiles)
+{
+    // symbols of the files scanned by the cancelled parse are incomplete
+    mPreprocessor.clearTempResults();
+    QSet<QString> files;
+    foreach (const QString& file, mPreprocessor.scannedFiles()) {
+        if (!oldScannedFiles.contains(file))
+            files.insert(file);
+    }
+    internalInvalidateFiles(files);
+}
+
+void CppParser::waitForParsingDone()
+{
+    QMutexLocker locker(&mMutex);
+    while (mParsing || mLockCount>0) {
+        // set it again, in case another parse is started before we wake up
+        mCancelled.storeRelease(1);
+        mParsingDone.wait(&mMutex);
+    }
+    mCancelled.storeRelease(0);
+    mParsing = true;
+}
+
+void CppParser::setParsingDone()
+{
+    QMutexLocker locker(&mMutex);
+    //symbols may be changed, so lookup results of the old serial are outdated
+    updateSerialId();
+    clearLookupCaches();
+    mParsing = false;
+    mParsingDone.wakeAll();
+}
+
+void CppParser::internalParseFiles(const QStringList &files)
+{
+    int threadCount = QThread::idealThreadCount();
+    if (!mParallelParsing || threadCount<2 || files.count()<2) {
+        foreach (const QString& file,files) {
+            if (isCancelled())
+                return;
+            mFilesScannedCount++;
+            emit onProgress(file,mFilesToScanCount,mFilesScannedCount);
+            if (!mPreprocessor.scannedFiles().contains(file)) {
+                internalParse(file);
+            }
+        }
+        return;
+    }
+    // Files are preprocessed and tokenized in the thread pool batch by batch.
+    // Statements are still built one file after another in the sorted order,
+    // so the results are the same as parsing them sequentially.
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+    // Headers shared by files are usually scanned by the first few files,
+    // so start with small batches to avoid preprocessing them again and again.
+    int batchSize = 1;
+    int i=0;
+    // Contents of the opened files are fetched here, the tasks only get copies of them.
+    const GetFileStreamCallBack& getFileStream = mPreprocessor.onGetFileStream();
+    QHash<QString,QStringList> openedContents;
+    QSet<QString> fetchedFiles;
+    auto fetchContents = [&](const QString& file) {
+        if (fetchedFiles.contains(file) || mPreprocessor.scannedFiles().contains(file))
+            return;
+        fetchedFiles.insert(file);
+        QStringList buffer;
+        if (getFileStream && getFileStream(file,buffer))
+            openedContents.insert(file,buffer);
+    };
+    while (i<files.count() && mEnabled && !isCancelled()) {
+        QStringList batch = files.mid(i,batchSize);
+        i+=batch.count();
+        batchSize = std::min(batchSize*2, threadCount*4);
+        foreach (const QString& file, batch) {
+            fetchContents(file);
+            // files it included when it was scanned last time
+            foreach (const QString& includedFile, mPreprocessor.includeGraph().includes(file))
+                fetchContents(includedFile);
+        }
+        QHash<QString,PCppPreprocessTask> tasks;
+        foreach (const QString& file, batch) {
+            if (mPreprocessor.scannedFiles().contains(file) || tasks.contains(file))
+                continue;
+            PCppPreprocessTask task = std::make_shared<CppPreprocessTask>(
+                        file,mPreprocessor,openedContents,fetchedFiles,
+                        mParseGlobalHeaders,mParseLocalHeaders,&mCancelled);
+            tasks.insert(file,task);
+            pool.start(task.get());
+        }
+        pool.waitForDone();
+        // results of the cancelled tasks are incomplete
+        if (isCancelled())
+            return;
+        foreach (const QString& file, batch) {
+            if (isCancelled())
+                return;
+            mFilesScannedCount++;
+            emit onProgress(file,mFilesToScanCount,mFilesScannedCount);
+            if (mPreprocessor.scannedFiles().contains(file))
+                continue;
+            PCppPreprocessTask task = tasks.value(file);
+            // some headers it scanned are already parsed by files before it,
+            // the result is different from parsing it sequentially
+            bool outdated = false;
+            foreach (const QString& scannedFile, task->newScannedFiles()) {
+                if (mPreprocessor.scannedFiles().contains(scannedFile)) {
+                    outdated = true;
+                    break;
+                }
+            }
+            // a file it read from the disk is opened in an editor
+            if (!outdated && getFileStream) {
+                foreach (const QString& unfetchedFile, task->unfetchedFiles()) {
+                    QStringList buffer;
+                    if (getFileStream(unfetchedFile,buffer)) {
+                        outdated = true;
+                        break;
+                    }
+                }
+            }
+            if (outdated) {
+                internalParse(file);
+                continue;
+            }
+            QWriteLocker stateLocker(&mStateLock);
+            {
+                QMutexLocker locker(&mMutex);
+                clearLookupCaches();
+            }
+            mPreprocessor.addScannedFiles(task->preprocessor(), task->newScannedFiles());
+            if (!task->contents().isEmpty())
+                mParsedFileContents.insert(file,task->contents());
+            else
+                mParsedFileContents.remove(file);
+            auto action = finally([this]{
+                mTokenizer.clear();
+            });
+            mTokenizer.swap(task->tokenizer());
+            int tokenCount = mTokenizer.tokenCount();
+            int oldStatementCount = mStatementList.count();
+            QElapsedTimer timer;
+            timer.start();
+            if (mTokenizer.tokenCount() > 0)
+                parseTokens();
+            if (isCancelled()) {
+                internalInvalidateFiles(task->newScannedFiles());
+                continue;
+            }
+            if (mCollectStatistics)
+                mStatistics.append(FileParseStatistics{file, task->preprocessTime(), task->tokenizeTime(),
+                                                       timer.nsecsElapsed(), tokenCount,
+                                                       mStatementList.count()-oldStatementCount});
+        }
+    }
+}
+
+static bool isDescendantOf(const PStatement& statement, const PStatement& ancestor)
+{
+    PStatement parent = statement->parentScope.lock();
+    while (parent) {
+        if (parent == ancestor)
+            return true;
+        parent = parent->parentScope.lock();
+    }
+    return false;
+}
+
+static bool hasAncestorInFile(const PStatement &statement, int fileId)
+{
+    PStatement parent = statement->parentScope.lock();
+    while (parent) {
+        if (parent->isShared())
+            return false;
+        if (parent->fileId==fileId)
+            return true;
+        parent = parent->parentScope.lock();
+    }
+    return false;
+}
+
+// index of the '{' starting the function body that ends at endLine
+static int findFunctionBodyStart(const CppTokenizer& tokenizer, int endLine)
+{
+    for (int i=0;i<tokenizer.tokenCount();i++) {
+        if (!tokenizer[i]->text.startsWith('{'))
+            continue;
+        int matchIndex = tokenizer[i]->matchIndex;
+        if (matchIndex>=0 && tokenizer[matchIndex]->line == endLine)
+            return i;
+    }
+    return -1;
+}
+
+bool CppParser::internalParseIncrementally(const QString &fileName)
+{
+    QWriteLocker stateLocker(&mStateLock);
+    QStringList oldContents = mParsedFileContents.value(fileName);
+    if (oldContents.isEmpty())
+        return false;
+    PFileIncludes fileIncludes = mPreprocessor.includesList().value(fileName);
+    if (!fileIncludes || !mPreprocessor.scannedFiles().contains(fileName))
+        return false;
+    QStringList newContents;
+    const GetFileStreamCallBack& getFileStream = mPreprocessor.onGetFileStream();
+    if (!getFileStream || !getFileStream(fileName,newContents))
+        return false;
+
+    //find changed lines
+    int oldCount = oldContents.count();
+    int newCount = newContents.count();
+    int prefix = 0;
+    while (prefix<oldCount && prefix<newCount
+           && oldContents[prefix]==newContents[prefix])
+        prefix++;
+    if (prefix == oldCount && prefix == newCount)
+        return false;
+    int suffix = 0;
+    while (suffix<oldCount-prefix && suffix<newCount-prefix
+           && oldContents[oldCount-suffix-1]==newContents[newCount-suffix-1])
+        suffix++;
+    // (1-based) lines before prefix+1 and after lastChangedLine are not changed
+    int lastChangedLine = oldCount - suffix;
+    int delta = newCount - oldCount;
+
+    //find the function whose body contains all the changes
+    const QVector<PCppScope>& scopes = fileIncludes->scopes.scopes();
+    PStatement function;
+    int scopeStart = -1;
+    int scopeEnd = -1;
+    QSet<Statement*> visited;
+    for (int i=0;i<scopes.count();i++) {
+        const PStatement& statement = scopes[i]->statement;
+        if (scopes[i]->startLine>prefix)
+            break;
+        if (!statement || visited.contains(statement.get()))
+            continue;
+        visited.insert(statement.get());
+        if (statement->kind != StatementKind::skFunction
+                && statement->kind != StatementKind::skConstructor
+                && statement->kind != StatementKind::skDestructor)
+            continue;
+        int j=i+1;
+        while (j<scopes.count()
+               && (scopes[j]->statement == statement
+                   || (scopes[j]->statement && isDescendantOf(scopes[j]->statement,statement))))
+            j++;
+        if (j<scopes.count() && scopes[j]->startLine>lastChangedLine) {
+            function = statement;
+            scopeStart = i;
+            scopeEnd = j;
+            break;
+        }
+    }
+    if (!function || function->isShared())
+        return false;
+    int headerLine = scopes[scopeStart]->startLine;
+    int endLine = scopes[scopeEnd]->startLine;
+    int newEndLine = endLine + delta;
+    if (endLine>oldCount || newEndLine>newCount)
+        return false;
+    //preprocessor directives may change the meaning of the whole file
+    for (int i=headerLine-1;i<endLine;i++) {
+        if (oldContents[i].trimmed().startsWith('#'))
+            return false;
+    }
+    for (int i=headerLine-1;i<newEndLine;i++) {
+        if (newContents[i].trimmed().startsWith('#'))
+            return false;
+    }
+
+    CppTokenizer oldTokenizer;
+    CppTokenizer newTokenizer;
+    oldTokenizer.tokenize(mPreprocessor.preprocessLines(
+                              fileName,
+                              oldContents.mid(headerLine-1,endLine-headerLine+1),
+                              headerLine));
+    QStringList newLines = mPreprocessor.preprocessLines(
+                fileName,
+                newContents.mid(headerLine-1,newEndLine-headerLine+1),
+                headerLine);
+    newTokenizer.tokenize(newLines);
+    int bodyStart = findFunctionBodyStart(oldTokenizer,endLine);
+    if (bodyStart<0 || findFunctionBodyStart(newTokenizer,newEndLine)!=bodyStart)
+        return false;
+    // the function header must be the same
+    for (int i=0;i<=bodyStart;i++) {
+        if (oldTokenizer[i]->text!=newTokenizer[i]->text)
+            return false;
+    }
+    // so do tokens after the body, and tokens in the last line
+    // (the body's braces are still paired with each other)
+    int oldBodyEnd = oldTokenizer[bodyStart]->matchIndex;
+    int bodyEnd = newTokenizer[bodyStart]->matchIndex;
+    int oldIndex = oldTokenizer.tokenCount()-1;
+    int newIndex = newTokenizer.tokenCount()-1;
+    if (oldIndex-oldBodyEnd != newIndex-bodyEnd)
+        return false;
+    while (oldIndex>=0 && newIndex>=0) {
+        bool oldInLastLine = oldTokenizer[oldIndex]->line == endLine;
+        bool newInLastLine = newTokenizer[newIndex]->line == newEndLine;
+        if (oldInLastLine != newInLastLine)
+            return false;
+        if (!oldInLastLine && oldIndex<oldBodyEnd)
+            break;
+        if (oldTokenizer[oldIndex]->text != newTokenizer[newIndex]->text)
+            return false;
+        oldIndex--;
+        newIndex--;
+    }
+
+    // statements parsed from the function body (parameters are parsed from the header)
+    auto isBodyStatement = [](const PStatement& statement, const PStatement& function) {
+        if (!statement)
+            return false;
+        PStatement top = statement;
+        PStatement parent = statement->parentScope.lock();
+        while (parent && parent!=function) {
+            top = parent;
+            parent = parent->parentScope.lock();
+        }
+        if (!parent)
+            return false;
+        return top->kind != StatementKind::skParameter
+                && top->command != "this"
+                && top->command != "__func__";
+    };
+    auto action = finally([this]{
+        mTokenizer.clear();
+        internalClear();
+    });
+
+    // parse the new body into a scratch copy of the function first, and leave
+    // everything untouched if it can't be parsed on its own (parseFile then
+    // parses the file and the files depending on it)
+    {
+        PStatement scratch = std::make_shared<Statement>(*function);
+        scratch->children.clear();
+        scratch->usingList.clear();
+        foreach (const PStatement& statement, function->children) {
+            if (!isBodyStatement(statement,function))
+                scratch->children.insert(statement->command,statement);
+        }
+        QVector<PCppScope> oldScopes = scopes;
+        CppTokenizer scratchTokenizer;
+        scratchTokenizer.tokenize(newLines);
+        mTokenizer.swap(scratchTokenizer);
+        bool finished = parseFunctionBody(fileName,scratch,headerLine,bodyStart+1,bodyEnd);
+        mTokenizer.clear();
+        for (auto it=fileIncludes->statements.begin();it!=fileIncludes->statements.end();) {
+            if (isDescendantOf(it.value(),scratch))
+                it = fileIncludes->statements.erase(it);
+            else
+                ++it;
+        }
+        foreach (const PStatement& statement, scratch->children.values()) {
+            if (statement->parentScope.lock()==scratch)
+                mStatementList.deleteStatementTree(statement);
+        }
+        fileIncludes->scopes.setScopes(oldScopes);
+        if (!finished)
+            return false;
+    }
+
+    for (auto it=fileIncludes->statements.begin();it!=fileIncludes->statements.end();) {
+        if (isBodyStatement(it.value(),function))
+            it = fileIncludes->statements.erase(it);
+        else
+            ++it;
+    }
+    foreach (const PStatement& statement, function->children.values()) {
+        if (isBodyStatement(statement,function))
+            mStatementList.deleteStatementTree(statement);
+    }
+    function->usingList.clear();
+    {
+        QMutexLocker locker(&mMutex);
+        clearLookupCaches();
+    }
+
+    // move statements after the function body
+    if (delta!=0) {
+        QSet<Statement*> moved;
+        foreach (const PStatement& statement, fileIncludes->statements) {
+            if (!statement || moved.contains(statement.get()) || statement->isShared())
+                continue;
+            moved.insert(statement.get());
+            if (statement == function || isDescendantOf(statement,function))
+                continue;
+            if (statement->fileName == fileName && statement->line>=endLine)
+                statement->line += delta;
+            if (statement->definitionFileName == fileName && statement->definitionLine>=endLine)
+                statement->definitionLine += delta;
+        }
+        moveReferencedLines(fileName,endLine,delta);
+    }
+    QVector<PCppScope> newScopes = scopes.mid(0,scopeStart+1);
+    QVector<PCppScope> tailScopes = scopes.mid(scopeEnd);
+
+    // parse the new body (it's parsed the same way as the scratch one)
+    mTokenizer.swap(newTokenizer);
+    parseFunctionBody(fileName,function,headerLine,bodyStart+1,bodyEnd);
+
+    // the first one is the function scope, which is already in newScopes
+    const QVector<PCppScope>& bodyScopes = fileIncludes->scopes.scopes();
+    for (int i=1;i<bodyScopes.count();i++)
+        newScopes.append(bodyScopes[i]);
+    foreach (const PCppScope& scope, tailScopes) {
+        PCppScope newScope = std::make_shared<CppScope>();
+        newScope->startLine = scope->startLine + delta;
+        newScope->statement = scope->statement;
+        newScopes.append(newScope);
+    }
+    fileIncludes->scopes.setScopes(newScopes);
+    mParsedFileContents.insert(fileName,newContents);
+    return true;
+}
+
+bool CppParser::parseFunctionBody(const QString &fileName, const PStatement &function,
+                                  int headerLine, int startIndex, int endIndex)
+{
+    internalClear();
+    PFileIncludes fileIncludes = mPreprocessor.includesList().value(fileName);
+    if (fileIncludes)
+        fileIncludes->scopes.clear();
+    mCurrentFile = fileName;
+    mIsSystemHeader = isSystemHeaderFile(mCurrentFile) || isProjectHeaderFile(mCurrentFile);
+    mIsProjectFile = mProjectFiles.contains(mCurrentFile);
+    mIsHeader = isHFile(mCurrentFile);
+    PStatement scopeStatement = function;
+    addSoloScopeLevel(scopeStatement,headerLine);
+    mIndex = startIndex;
+#ifdef QT_DEBUG
+    mLastIndex = -1;
+#endif
+    while (mIndex<endIndex) {
+        if (!handleStatement())
+            break;
+    }
+    return (mIndex == endIndex && mCurrentScope.count()==1);
+}
+
+void CppParser::parseTokens()
+{
+#ifdef QT_DEBUG
+        mLastIndex = -1;
+#endif
+    //    timer.restart();
+    // Process the token list
+    while(!isCancelled()) {
+        if (!handleStatement())
+            break;
+    }
+    //    qDebug()<<"parse"<<timer.elapsed();
+#ifdef QT_DEBUG
+//        mStatementList.dumpAll(QString("r:\\all-stats-%1.txt").arg(extractFileName(fileName)));
+//        mStatementList.dump(QString("r:\\stats-%1.txt").arg(extractFileName(fileName)));
+#endif
+    //reduce memory usage
+    internalClear();
 }
 
 void CppParser::inheritClassStatement(const PStatement& derived, bool isStruct,
@@ -4087,28 +4948,281 @@ void CppParser::inheritClassStatement(const PStatement& derived, bool isStruct,
         else
             access = StatementAccessibility::Private;
     }
-    foreach (const PStatement& statement, base->children) {
-        if (statement->accessibility == StatementAccessibility::Private
-                || statement->kind == StatementKind::skConstructor
-                || statement->kind == StatementKind::skDestructor)
+    //members of the base are not copied, they are found through the link when needed
+    BaseClassInfo baseClass;
+    baseClass.statement = base;
+    baseClass.fullName = base->fullName;
+    baseClass.access = access;
+    derived->baseClasses.append(baseClass);
+}
+
+StatementMap CppParser::doGetInheritedMembers(const PStatement &classStatement) const
+{
+    if (!classStatement
+            || classStatement->kind != StatementKind::skClass
+            || classStatement->baseClasses.isEmpty())
+        return StatementMap();
+    PInheritedMembers inherited = mInheritedMembers.value(classStatement.get());
+    if (inherited && inherited->classStatement.lock() == classStatement)
+        return inherited->members;
+    inherited = std::make_shared<InheritedMembers>();
+    inherited->classStatement = classStatement;
+    //add it before resolving, so classes inheriting each other by mistake won't loop forever
+    mInheritedMembers.insert(classStatement.get(),inherited);
+    StatementMap members;
+    foreach (const BaseClassInfo& baseClass, classStatement->baseClasses) {
+        PStatement base = baseClass.statement.lock();
+        // the base class is reparsed
+        if (!base)
+            base = doFindStatement(baseClass.fullName);
+        if (!base || base->kind != StatementKind::skClass || base == classStatement)
             continue;
-        StatementAccessibility m_acc;
-        switch(access) {
-        case StatementAccessibility::Public:
-            m_acc = statement->accessibility;
-            break;
-        case StatementAccessibility::Protected:
-            m_acc = StatementAccessibility::Protected;
-            break;
-        case StatementAccessibility::Private:
-            m_acc = StatementAccessibility::Private;
-            break;
-        default:
-            m_acc = StatementAccessibility::Private;
+        const StatementMap& baseChildren = mStatementList.childrenStatements(base);
+        StatementList baseMembers = baseChildren.values();
+        //members of the base's bases, unless hidden by the base's own ones
+        StatementMap baseInherited = doGetInheritedMembers(base);
+        for (auto it=baseInherited.constBegin();it!=baseInherited.constEnd();++it) {
+            if (!baseChildren.contains(it.key()))
+                baseMembers.append(it.value());
+        }
+        foreach (const PStatement& statement, baseMembers) {
+            if (statement->accessibility == StatementAccessibility::Private
+                    || statement->kind == StatementKind::skConstructor
+                    || statement->kind == StatementKind::skDestructor)
+                continue;
+            StatementAccessibility m_acc;
+            switch(baseClass.access) {
+            case StatementAccessibility::Public:
+                m_acc = statement->accessibility;
+                break;
+            case StatementAccessibility::Protected:
+                m_acc = StatementAccessibility::Protected;
+                break;
+            case StatementAccessibility::Private:
+                m_acc = StatementAccessibility::Private;
+                break;
+            default:
+                m_acc = StatementAccessibility::Private;
+            }
+            members.insert(statement->command,
+                           createInheritedStatement(classStatement,statement,m_acc));
         }
-        //inherit
-        addInheritedStatement(derived,statement,m_acc);
     }
+    inherited->members = members;
+    return members;
+}
+
+void CppParser::updateSemanticTokens(const QStringList &files)
+{
+    foreach (const QString& file, files) {
+        if (isCancelled())
+            return;
+        // only changed by the parse, which runs in this thread
+        QStringList contents = mParsedFileContents.value(file);
+        bool opened = !contents.isEmpty();
+        // references are recorded for opened files and project files
+        std::shared_ptr<FileReferences> references;
+        if (opened || mProjectFiles.contains(file)) {
+            references = std::make_shared<FileReferences>();
+            if (!opened)
+                contents = readFileToLines(file);
+        }
+        PFileSemanticTokens tokens;
+        if (!contents.isEmpty()) {
+            // lookups and freeze() are not blocked, the tables are only published under mMutex
+            QReadLocker stateLocker(&mStateLock);
+            tokens = buildSemanticTokens(file, contents, references.get());
+            if (!tokens)
+                return;
+        }
+        QMutexLocker locker(&mMutex);
+        if (tokens && opened)
+            mSemanticTokens.insert(file,tokens);
+        else
+            mSemanticTokens.remove(file);
+        if (references && tokens) {
+            references->lines = contents;
+            mReferences.insert(file,references);
+        } else {
+            mReferences.remove(file);
+        }
+    }
+}
+
+void CppParser::moveReferencedLines(const QString &fileName, int fromLine, int delta)
+{
+    QString prefix = fileName + '\n';
+    QMutexLocker locker(&mMutex);
+    for (auto it=mReferences.begin();it!=mReferences.end();++it) {
+        const PFileReferences& oldReferences = it.value();
+        bool moved = false;
+        for (auto refIt=oldReferences->references.constBegin();
+             refIt!=oldReferences->references.constEnd();++refIt) {
+            if (refIt.key().startsWith(prefix)
+                    && refIt.key().mid(prefix.length()).toInt()>=fromLine) {
+                moved = true;
+                break;
+            }
+        }
+        if (!moved)
+            continue;
+        //the tables are shared with readers, replace it with a new one
+        std::shared_ptr<FileReferences> references = std::make_shared<FileReferences>();
+        references->lines = oldReferences->lines;
+        references->unresolvedNames = oldReferences->unresolvedNames;
+        for (auto refIt=oldReferences->references.constBegin();
+             refIt!=oldReferences->references.constEnd();++refIt) {
+            QString key = refIt.key();
+            if (key.startsWith(prefix)) {
+                int line = key.mid(prefix.length()).toInt();
+                if (line>=fromLine)
+                    key = FileReferences::referenceKey(fileName, line+delta);
+            }
+            references->references.insert(key,refIt.value());
+        }
+        it.value() = references;
+    }
+}
+
+void CppParser::dropReferencesOfDependents(const QString &fileName)
+{
+    QSet<QString> files = mPreprocessor.includeGraph().includedBy(fileName);
+    QMutexLocker locker(&mMutex);
+    foreach (const QString& file, files) {
+        mReferences.remove(file);
+    }
+}
+
+static bool isMemberAccessToken(const QString& token)
+{
+    return token == "::" || token == "." || token == "->";
+}
+
+PFileSemanticTokens CppParser::buildSemanticTokens(const QString &fileName,
+                                                   const QStringList &contents,
+                                                   FileReferences *references)
+{
+    std::shared_ptr<FileSemanticTokens> result = std::make_shared<FileSemanticTokens>();
+    result->lines = contents;
+    result->tokens.resize(contents.count());
+    // statements of the expressions already resolved in the scope
+    QHash<QString, PStatement> resolvedStatements;
+    QSynedit::CppSyntaxer syntaxer;
+    syntaxer.resetState();
+    QString lastTokenOfPrevLine;
+    for (int i=0;i<contents.count();i++) {
+        if (isCancelled())
+            return PFileSemanticTokens();
+        const QString& lineText = contents[i];
+        int line = i+1;
+        // use the same tokens as the editor
+        syntaxer.setLine(lineText,i);
+        QStringList tokens;
+        QVector<int> positions;
+        QVector<bool> identifiers;
+        while (!syntaxer.eol()) {
+            QSynedit::TokenType tokenType = syntaxer.getTokenAttribute()->tokenType();
+            if (tokenType != QSynedit::TokenType::Comment
+                    && tokenType != QSynedit::TokenType::Space) {
+                tokens.append(syntaxer.getToken());
+                positions.append(syntaxer.getTokenPos());
+                identifiers.append(tokenType == QSynedit::TokenType::Identifier);
+            }
+            syntaxer.next();
+        }
+        QString prevLineEnd = lastTokenOfPrevLine;
+        if (!tokens.isEmpty())
+            lastTokenOfPrevLine = tokens.last();
+        if (isIncludeLine(lineText))
+            continue;
+        PStatement scope;
+        bool scopeFound = false;
+        for (int j=0;j<tokens.count();j++) {
+            if (!identifiers[j])
+                continue;
+            // the same expression getExpressionAtPosition() gives for simple member chains
+            QStringList expression;
+            expression.append(tokens[j]);
+            int k = j-1;
+            while (k>=1 && isMemberAccessToken(tokens[k]) && identifiers[k-1]) {
+                expression.prepend(tokens[k]);
+                expression.prepend(tokens[k-1]);
+                k-=2;
+            }
+            if (k>=0 && tokens[k] == "::"
+                    && (k==0 || (!identifiers[k-1] && tokens[k-1]!=">"
+                                 && tokens[k-1]!=")" && tokens[k-1]!="]"))) {
+                expression.prepend(tokens[k]);
+                k--;
+            }
+            // leave complex ones ("a[0].b", "f().c", "T<int>::d", "~A" ...) to the editor
+            if ((k>=0 && (isMemberAccessToken(tokens[k]) || tokens[k] == "~"))
+                    || (k<0 && isMemberAccessToken(prevLineEnd))) {
+                if (references)
+                    references->unresolvedNames.insert(tokens[j]);
+                continue;
+            }
+            if (!scopeFound) {
+                QMutexLocker locker(&mMutex);
+                scope = doFindScopeStatement(fileName,line);
+                scopeFound = true;
+            }
+            QString key = lookupScopeKey(scope) + ' ' + expression.join(' ');
+            PStatement statement;
+            auto it = resolvedStatements.constFind(key);
+            if (it != resolvedStatements.constEnd()) {
+                statement = it.value();
+            } else {
+                // lookups share the caches with readers
+                QMutexLocker locker(&mMutex);
+                statement = doFindStatementOf(fileName,expression,scope);
+                resolvedStatements.insert(key,statement);
+            }
+            // the same as doFindStatementOf(fileName,expression,line)
+            if (statement && statement->line != line
+                    && statement->definitionLine != line) {
+                PStatement parentStatement = statement->parentScope.lock();
+                if (parentStatement &&
+                        (parentStatement->line == line && parentStatement->fileName == fileName))
+                    statement = parentStatement;
+            }
+            result->tokens[i].append(SemanticToken{positions[j]+1, tokens[j].length(),
+                                                   getKindOfStatement(statement)});
+            if (references && statement)
+                references->references[FileReferences::referenceKey(statement)].append(
+                            SymbolReference{line, positions[j]+1, tokens[j].length()});
+        }
+    }
+    return result;
+}
+
+PStatement CppParser::createInheritedStatement(const PStatement &derived, const PStatement &inherit, StatementAccessibility access) const
+{
+    //it's not added to the statement list, and lives in mInheritedMembers
+    PStatement statement = std::make_shared<Statement>();
+    statement->parentScope = derived;
+    statement->type = inherit->type;
+    statement->command = inherit->command;
+    statement->args = inherit->args;
+    statement->noNameArgs = inherit->noNameArgs;
+    statement->value = inherit->value;
+    statement->kind = inherit->kind;
+    statement->scope = inherit->scope;
+    statement->accessibility = access;
+    statement->line = inherit->line;
+    statement->definitionLine = inherit->definitionLine;
+    statement->fileName = inherit->fileName;
+    statement->definitionFileName = inherit->definitionFileName;
+    statement->fileId = inherit->fileId;
+    statement->definitionFileId = inherit->definitionFileId;
+    statement->fullName = getFullStatementName(inherit->command, derived);
+    statement->properties = inherit->properties | StatementProperty::spInherited;
+    statement->setIsShared(false);
+    statement->setInProject(derived->inProject());
+    statement->setInSystemHeader(derived->inSystemHeader());
+    statement->baseClasses = inherit->baseClasses;
+    statement->usageCount = -1;
+    return statement;
 }
 
 void CppParser::fillListOfFunctions(const QString& fileName, int line,
@@ -4116,6 +5230,9 @@ void CppParser::fillListOfFunctions(const QString& fileName, int line,
                                     const PStatement& scopeStatement, QStringList &list)
 {
     StatementMap children = mStatementList.childrenStatements(scopeStatement);
+    //overloads in the base classes are hidden by the ones in the class
+    if (!children.contains(statement->command))
+        children = doGetInheritedMembers(scopeStatement);
     for (const PStatement& child:children) {
         if ((statement->command == child->command)
 #ifdef Q_OS_WIN
@@ -4134,6 +5251,9 @@ QList<PStatement> CppParser::getListOfFunctions(const QString &fileName, int lin
 {
     QList<PStatement> result;
     StatementMap children = mStatementList.childrenStatements(scopeStatement);
+    //overloads in the base classes are hidden by the ones in the class
+    if (!children.contains(statement->command))
+        children = doGetInheritedMembers(scopeStatement);
     for (const PStatement& child:children) {
         if (( (statement->command == child->command)
 #ifdef Q_OS_WIN
@@ -4158,8 +5278,8 @@ PStatement CppParser::findMacro(const QString &phrase, const QString &fileName)
     PFileIncludes includes = mPreprocessor.includesList().value(fileName,PFileIncludes());
     foreach (const PStatement& s, statements) {
         if (s->kind == StatementKind::skPreprocessor) {
-            if (includes && !includes->includeFiles.contains(s->fileName)
-                    && !includes->includeFiles.contains(s->definitionFileName))
+            if (includes && !includes->includeFileIds.contains(s->fileId)
+                    && !includes->includeFileIds.contains(s->definitionFileId))
                 continue;
             return s;
         }
@@ -4171,7 +5291,8 @@ PStatement CppParser::findMemberOfStatement(const QString &phrase,
                                             const PStatement& scopeStatement) const
 {
     const StatementMap& statementMap =mStatementList.childrenStatements(scopeStatement);
-    if (statementMap.isEmpty())
+    if (statementMap.isEmpty()
+            && (!scopeStatement || scopeStatement->baseClasses.isEmpty()))
         return PStatement();
 
     QString s = phrase;
@@ -4189,13 +5310,17 @@ PStatement CppParser::findMemberOfStatement(const QString &phrase,
     if (p>=0)
         s.truncate(p);
 
-    return statementMap.value(s,PStatement());
+    PStatement statement = statementMap.value(s,PStatement());
+    if (!statement)
+        statement = doGetInheritedMembers(scopeStatement).value(s,PStatement());
+    return statement;
 }
 
 QList<PStatement> CppParser::findMembersOfStatement(const QString &phrase, const PStatement &scopeStatement) const
 {
     const StatementMap& statementMap =mStatementList.childrenStatements(scopeStatement);
-    if (statementMap.isEmpty())
+    if (statementMap.isEmpty()
+            && (!scopeStatement || scopeStatement->baseClasses.isEmpty()))
         return QList<PStatement>();
 
     QString s = phrase;
@@ -4213,7 +5338,10 @@ QList<PStatement> CppParser::findMembersOfStatement(const QString &phrase, const
     if (p>=0)
         s.truncate(p);
 
-    return statementMap.values(s);
+    QList<PStatement> statements = statementMap.values(s);
+    if (statements.isEmpty())
+        statements = doGetInheritedMembers(scopeStatement).values(s);
+    return statements;
 }
 
 PStatement CppParser::findStatementInScope(const QString &name, const QString &noNameArgs,
@@ -5435,6 +6563,12 @@ void CppParser::internalInvalidateFile(const QString &fileName)
 {
     if (fileName.isEmpty())
         return;
+    QWriteLocker stateLocker(&mStateLock);
+    //lookups run between the files of a parse, don't let them get freed statements
+    {
+        QMutexLocker locker(&mMutex);
+        clearLookupCaches();
+    }
 
     // remove its include files list
     PFileIncludes p = findFileIncludes(fileName, true);
@@ -5442,16 +6576,23 @@ void CppParser::internalInvalidateFile(const QString &fileName)
         //fPreprocessor.InvalidDefinesInFile(FileName); //we don't need this, since we reset defines after each parse
         //p->includeFiles.clear();
         //p->usings.clear();
+        int fileId = FileIdTable::idOf(fileName);
         for (PStatement& statement:p->statements) {
-            if (statement->fileName==fileName) {
-                mStatementList.deleteStatement(statement);
-            } else {
+            if (statement->fileId==fileId) {
+                //the whole subtree is deleted with its top-most statement in this file
+                if (!hasAncestorInFile(statement,fileId))
+                    mStatementList.deleteStatementTree(statement);
+            } else if (!statement->isShared()) {
                 statement->setHasDefinition(false);
                 statement->definitionFileName = statement->fileName;
+                statement->definitionFileId = statement->fileId;
                 statement->definitionLine = statement->line;
             }
         }
-        p->statements.clear();
+        //include records in the shared snapshot are read-only
+        if (!mSystemHeaderSymbols
+                || mSystemHeaderSymbols->includes.value(fileName)!=p)
+            p->statements.clear();
     }
 
     //remove all statements from namespace cache
@@ -5471,10 +6612,13 @@ void CppParser::internalInvalidateFile(const QString &fileName)
 
     // delete it from scannedfiles
     mPreprocessor.removeScannedFile(fileName);
+    mCachedSystemHeaders.remove(fileName);
+    mParsedFileContents.remove(fileName);
 }
 
 void CppParser::internalInvalidateFiles(const QSet<QString> &files)
 {
+    QWriteLocker stateLocker(&mStateLock);
     for (const QString& file:files)
         internalInvalidateFile(file);
 }
@@ -5485,11 +6629,9 @@ QSet<QString> CppParser::calculateFilesToBeReparsed(const QString &fileName)
         return QSet<QString>();
     QSet<QString> result;
     result.insert(fileName);
-    foreach (const QString& file, mProjectFiles) {
-        PFileIncludes fileIncludes = mPreprocessor.includesList().value(file,PFileIncludes());
-        if (fileIncludes && fileIncludes->includeFiles.contains(fileName)) {
+    foreach (const QString& file, mPreprocessor.includeGraph().includedBy(fileName)) {
+        if (mProjectFiles.contains(file))
             result.insert(file);
-        }
     }
     return result;
 }
@@ -5787,9 +6929,27 @@ bool CppParser::isTypeStatement(StatementKind kind) const
 
 void CppParser::updateSerialId()
 {
+    mSerialCount++;
     mSerialId = QString("%1 %2").arg(mParserId).arg(mSerialCount);
 }
 
+void CppParser::clearLookupCaches()
+{
+    mStatementLookupCache.clear();
+    mEvalLookupCache.clear();
+    mInheritedMembers.clear();
+}
+
+void CppParser::prepareLookupCache()
+{
+    if (mLookupCacheSerialId != mSerialId
+            || mStatementLookupCache.count() + mEvalLookupCache.count() > LOOKUP_CACHE_MAX_SIZE) {
+        mStatementLookupCache.clear();
+        mEvalLookupCache.clear();
+        mLookupCacheSerialId = mSerialId;
+    }
+}
+
 int CppParser::indexOfNextSemicolon(int index, int endIndex)
 {
     if (endIndex<0)
@@ -6121,6 +7281,48 @@ void CppParser::setParseLocalHeaders(bool newParseLocalHeaders)
     mParseLocalHeaders = newParseLocalHeaders;
 }
 
+bool CppParser::parallelParsing() const
+{
+    return mParallelParsing;
+}
+
+void CppParser::setParallelParsing(bool newParallelParsing)
+{
+    mParallelParsing = newParallelParsing;
+}
+
+bool CppParser::collectStatistics() const
+{
+    return mCollectStatistics;
+}
+
+void CppParser::setCollectStatistics(bool newCollectStatistics)
+{
+    mCollectStatistics = newCollectStatistics;
+}
+
+const QList<FileParseStatistics> &CppParser::statistics() const
+{
+    return mStatistics;
+}
+
+void CppParser::clearStatistics()
+{
+    mStatistics.clear();
+}
+
+int CppParser::lookupCacheHits()
+{
+    QMutexLocker locker(&mMutex);
+    return mLookupCacheHits;
+}
+
+int CppParser::lookupCacheMisses()
+{
+    QMutexLocker locker(&mMutex);
+    return mLookupCacheMisses;
+}
+
 const QString &CppParser::serialId() const
 {
     return mSerialId;
@@ -6161,60 +7363,13 @@ void CppParser::setEnabled(bool newEnabled)
     }
 }
 
-CppFileParserThread::CppFileParserThread(
-        PCppParser parser,
-        QString fileName,
-        bool inProject,
-        bool onlyIfNotParsed,
-        bool updateView,
-        QObject *parent):QThread(parent),
-    mParser(parser),
-    mFileName(fileName),
-    mInProject(inProject),
-    mOnlyIfNotParsed(onlyIfNotParsed),
-    mUpdateView(updateView)
-{
-    connect(this,&QThread::finished,
-            this,&QObject::deleteLater);
-}
-
-void CppFileParserThread::run()
-{
-    if (mParser && !mParser->parsing()) {
-        mParser->parseFile(mFileName,mInProject,mOnlyIfNotParsed,mUpdateView);
-    }
-}
-
-CppFileListParserThread::CppFileListParserThread(PCppParser parser,
-                                                 bool updateView, QObject *parent):
-    QThread(parent),
-    mParser(parser),
-    mUpdateView(updateView)
-{
-    connect(this,&QThread::finished,
-            this,&QObject::deleteLater);
-}
-
-void CppFileListParserThread::run()
-{
-    if (mParser && !mParser->parsing()) {
-        mParser->parseFileList(mUpdateView);
-    }
-}
-
-void parseFile(PCppParser parser, const QString& fileName, bool inProject, bool onlyIfNotParsed, bool updateView)
+void parseFile(PCppParser parser, const QString& fileName, bool inProject, bool onlyIfNotParsed, bool updateView, ParsePriority priority)
 {
     if (!parser)
         return;
     if (!parser->enabled())
         return;
-    //delete when finished
-    CppFileParserThread* thread = new CppFileParserThread(parser,fileName,inProject,onlyIfNotParsed,updateView);
-    thread->connect(thread,
-                    &QThread::finished,
-                    thread,
-                    &QThread::deleteLater);
-    thread->start();
+    ParseScheduler::instance()->scheduleFile(parser,fileName,inProject,onlyIfNotParsed,updateView,priority);
 }
 
 void parseFileList(PCppParser parser, bool updateView)
@@ -6223,11 +7378,5 @@ void parseFileList(PCppParser parser, bool updateView)
         return;
     if (!parser->enabled())
         return;
-    //delete when finished
-    CppFileListParserThread *thread = new CppFileListParserThread(parser,updateView);
-    thread->connect(thread,
-                    &QThread::finished,
-                    thread,
-                    &QThread::deleteLater);
-    thread->start();
+    ParseScheduler::instance()->scheduleFileList(parser,updateView,ParsePriority::Background);
 }
@@ -17,13 +17,21 @@
 #ifndef CPPPARSER_H
 #define CPPPARSER_H
 
+#include <QAtomicInt>
 #include <QMutex>
+#include <QReadWriteLock>
 #include <QObject>
 #include <QThread>
 #include <QVector>
+#include <QWaitCondition>
 #include "statementmodel.h"
 #include "cpptokenizer.h"
 #include "cpppreprocessor.h"
+#include "systemheadercache.h"
+#include "parsescheduler.h"
+
+#define FREEZE_WAIT_TIMEOUT 100
+#define LOOKUP_CACHE_MAX_SIZE 10000
 
 class CppParser : public QObject
 {
@@ -75,7 +83,18 @@ public:
     PStatement findStatementOf(const QString& fileName,
                                const QStringList& expression,
                                int line);
+    // for other threads working while the caller holds freeze(), waits instead of failing
+    // when a parse is queued for the state lock
+    PStatement findStatementOfWhileFrozen(const QString& fileName,
+                               const QStringList& expression,
+                               int line);
     PStatement findAliasedStatement(const PStatement& statement);
+    // members inherited from the base classes, resolved when asked for
+    StatementMap getInheritedMembers(const PStatement& classStatement);
+    // identifier kinds of an opened file from its last parse, doesn't wait for the running parse
+    PFileSemanticTokens semanticTokens(const QString& fileName);
+    // symbol references of an opened or project file from its last parse
+    PFileReferences references(const QString& fileName);
 
     /**
      * @brief evaluate the expression
@@ -92,11 +111,15 @@ public:
                                     const PStatement& currentClass);
     PStatement findTypeDef(const PStatement& statement,
                           const QString& fileName);
-    bool freeze();  // Freeze/Lock (stop reparse while searching)
-    bool freeze(const QString& serialId);  // Freeze/Lock (stop reparse while searching)
+    // Freeze/Lock (stop reparse while searching), waits a little for the running parse.
+    // Don't call them in the GUI thread, use tryFreeze() there.
+    bool freeze();
+    bool freeze(const QString& serialId);
+    bool tryFreeze(); // freeze without waiting for the running parse
     QStringList getClassesList();
     QStringList getFileDirectIncludes(const QString& filename);
     QSet<QString> getFileIncludes(const QString& filename);
+    FileIdSet getFileIncludeIds(const QString& filename);
     QSet<QString> getFileUsings(const QString& filename);
 
     QString getHeaderFileName(const QString& relativeTo, const QString& headerName, bool fromNext=false);// both
@@ -106,12 +129,27 @@ public:
     bool isIncludeNextLine(const QString &line);
     bool isProjectHeaderFile(const QString& fileName);
     bool isSystemHeaderFile(const QString& fileName);
-    void parseFile(const QString& fileName, bool inProject,
+    // return false if the parser is busy, and nothing is parsed
+    bool parseFile(const QString& fileName, bool inProject,
                    bool onlyIfNotParsed = false, bool updateView = true);
-    void parseFileList(bool updateView = true);
+    bool parseFileList(bool updateView = true);
     void parseHardDefines();
     bool parsing() const;
+    // ask the running parse to stop as soon as possible, files it hasn't finished are left unparsed
+    void cancelParsing();
     void resetParser();
+    /**
+     * @brief share symbols parsed from system headers with other parsers,
+     * and optionally cache them on disk.
+     *
+     * Should be called after include paths and hard defines are set.
+     * If another parser of the same environment has a snapshot of the system headers,
+     * or a valid cache exists, its symbols are loaded and the system headers
+     * in it won't be parsed again.
+     * @param compilerSetId identifies the compiler set that provides the paths/defines
+     * @param cacheFolder where the cache files are saved. Empty to disable the disk cache.
+     */
+    void setSystemHeaderCache(const QString& compilerSetId, const QString& cacheFolder=QString());
     void unFreeze(); // UnFree/UnLock (reparse while searching)
     QSet<QString> scannedFiles();
 
@@ -131,12 +169,25 @@ public:
 
     const QString &serialId() const;
 
+    // lookups answered from / missed the lookup cache
+    int lookupCacheHits();
+    int lookupCacheMisses();
+
     bool parseLocalHeaders() const;
     void setParseLocalHeaders(bool newParseLocalHeaders);
 
     bool parseGlobalHeaders() const;
     void setParseGlobalHeaders(bool newParseGlobalHeaders);
 
+    bool parallelParsing() const;
+    void setParallelParsing(bool newParallelParsing);
+
+    bool collectStatistics() const;
+    void setCollectStatistics(bool newCollectStatistics);
+    // timing of each file parsed, while collectStatistics is on
+    const QList<FileParseStatistics> &statistics() const;
+    void clearStatistics();
+
     const QSet<QString>& includePaths();
     const QSet<QString>& projectIncludePaths();
 
@@ -155,11 +206,6 @@ signals:
     void onStartParsing();
     void onEndParsing(int total, int updateView);
 private:
-    PStatement addInheritedStatement(
-            const PStatement& derived,
-            const PStatement& inherit,
-            StatementAccessibility access);
-
     PStatement addChildStatement(
             // support for multiple parents (only typedef struct/union use multiple parents)
             const PStatement& parent,
@@ -174,6 +220,7 @@ private:
             const StatementScope& scope,
             const StatementAccessibility& classScope,
             StatementProperties properties); // TODO: InheritanceList not supported
+    int fileIdOf(const QString& fileName);
     PStatement addStatement(
             const PStatement& parent,
             const QString &fileName,
@@ -211,6 +258,11 @@ private:
     }
 
     void internalClear();
+    void addNamespaceStatement(const PStatement& namespaceStatement);
+
+    void loadSystemHeaderSymbols(const PSystemHeaderSymbols& symbols);
+    PSystemHeaderSymbols collectSystemHeaderSymbols(const QSet<QString>& headers) const;
+    void updateSystemHeaderSymbols();
 
     QStringList sortFilesByIncludeRelations(const QSet<QString> &files);
 
@@ -493,13 +545,47 @@ private:
     void handleStructs(bool isTypedef = false);
     void handleUsing();
     void handleVar(const QString& typePrefix,bool isExtern,bool isStatic);
-    void internalParse(const QString& fileName);
+    // reparse: the file is scanned before, and is invalidated right before its new statements are built
+    void internalParse(const QString& fileName, bool reparse=false);
+    void internalParseFiles(const QStringList& files);
+    bool isCancelled() const;
+    void discardCancelledParse(const QSet<QString>& oldScannedFiles);
+    void waitForParsingDone();
+    void setParsingDone();
+    /**
+     * @brief reparse only the function body that contains all changes of the file
+     * @return false if changes are not inside a function body.
+     */
+    bool internalParseIncrementally(const QString& fileName);
+    // parse the tokens [startIndex, endIndex) as the body of the function,
+    // returns false if they don't end at endIndex
+    bool parseFunctionBody(const QString& fileName, const PStatement& function,
+                           int headerLine, int startIndex, int endIndex);
+    void parseTokens();
 //    function FindMacroDefine(const Command: AnsiString): PStatement;
     void inheritClassStatement(
             const PStatement& derived,
             bool isStruct,
             const PStatement& base,
             StatementAccessibility access);
+    StatementMap doGetInheritedMembers(const PStatement& classStatement) const;
+    // must be called with mMutex locked
+    PStatement cachedFindStatementOf(const QString& fileName,
+                               const QStringList& expression,
+                               int line);
+    void updateSemanticTokens(const QStringList& files);
+    // statements of the file from fromLine are moved, so are the references to them
+    void moveReferencedLines(const QString& fileName, int fromLine, int delta);
+    // statements of the file are recreated, references to them in the files
+    // including it can't be trusted until those files are parsed again
+    void dropReferencesOfDependents(const QString& fileName);
+    PFileSemanticTokens buildSemanticTokens(const QString& fileName,
+                                            const QStringList& contents,
+                                            FileReferences* references);
+    PStatement createInheritedStatement(
+            const PStatement& derived,
+            const PStatement& inherit,
+            StatementAccessibility access) const;
     PStatement doFindStatementInScope(const QString& name,
                                       const QString& noNameArgs,
                                       StatementKind kind,
@@ -642,6 +728,9 @@ private:
     bool isTypeStatement(StatementKind kind) const;
 
     void updateSerialId();
+    void prepareLookupCache();
+    // must be called with mMutex locked
+    void clearLookupCaches();
 
     int indexOfNextSemicolon(int index, int endIndex=-1);
     int indexOfNextPeriodOrSemicolon(int index, int endIndex=-1);
@@ -689,12 +778,39 @@ private:
     int mFilesScannedCount; // count of files that have been scanned
     int mFilesToScanCount; // count of files and files included in files that have to be scanned
     bool mParseLocalHeaders;
+    bool mParallelParsing; // preprocess/tokenize files in the thread pool
+    bool mCollectStatistics;
+    QList<FileParseStatistics> mStatistics;
     bool mParseGlobalHeaders;
     bool mIsProjectFile;
     int mLockCount; // lock(don't reparse) when we need to find statements in a batch
     bool mParsing;
+    QAtomicInt mCancelled;
+    QWaitCondition mParsingDone; // signaled when mParsing is cleared or mLockCount is decreased
+    // symbols and include records are written by the parse under the write lock (one file at a time),
+    // lookups and freeze() read them under the read lock
+    QReadWriteLock mStateLock;
     QHash<QString,PStatementList> mNamespaces;  // namespace and the statements in its scope
     QSet<QString> mInlineNamespaces;
+    QString mSystemHeaderCacheFile;
+    QString mSystemHeaderCacheKey;
+    QSet<QString> mCachedSystemHeaders; // system headers that are already in the snapshot
+    PSystemHeaderSymbols mSystemHeaderSymbols; // the shared snapshot used by this parser
+    QHash<QString,QStringList> mParsedFileContents; // contents of the opened files when they are parsed
+    // results of findStatementOf()/evalExpression(), only valid for the serial id they're built with
+    QString mLookupCacheSerialId;
+    QHash<QString,PStatement> mStatementLookupCache;
+    QHash<QString,PEvalStatement> mEvalLookupCache;
+    // built by lookups, dropped when symbols are changed
+    mutable QHash<const Statement*,PInheritedMembers> mInheritedMembers;
+    // only guarded by mMutex, so painting can use the old tables while files are parsed
+    QHash<QString,PFileSemanticTokens> mSemanticTokens;
+    QHash<QString,PFileReferences> mReferences; // guarded the same as mSemanticTokens
+    int mLookupCacheHits;
+    int mLookupCacheMisses;
+    StringPool mStringPool; // strings of statements
+    QString mLastFileIdName; // cache of the last fileIdOf() query
+    int mLastFileId;
 #ifdef QT_DEBUG
     int mLastIndex;
 #endif
@@ -704,51 +820,13 @@ private:
 };
 using PCppParser = std::shared_ptr<CppParser>;
 
-class CppFileParserThread : public QThread {
-    Q_OBJECT
-public:
-    explicit CppFileParserThread(
-            PCppParser parser,
-            QString fileName,
-            bool inProject,
-            bool onlyIfNotParsed = false,
-            bool updateView = true,
-            QObject *parent = nullptr);
-
-private:
-    PCppParser mParser;
-    QString mFileName;
-    bool mInProject;
-    bool mOnlyIfNotParsed;
-    bool mUpdateView;
-
-    // QThread interface
-protected:
-    void run() override;
-};
-using PCppParserThread = std::shared_ptr<CppFileParserThread>;
-
-class CppFileListParserThread: public QThread {
-    Q_OBJECT
-public:
-    explicit CppFileListParserThread(
-            PCppParser parser,
-            bool updateView = true,
-            QObject *parent = nullptr);
-private:
-    PCppParser mParser;
-    bool mUpdateView;
-    // QThread interface
-protected:
-    void run() override;
-};
-
 void parseFile(
     PCppParser parser,
     const QString& fileName,
     bool inProject,
     bool onlyIfNotParsed = false,
-    bool updateView = true);
+    bool updateView = true,
+    ParsePriority priority = ParsePriority::Normal);
 
 void parseFileList(
         PCppParser parser,
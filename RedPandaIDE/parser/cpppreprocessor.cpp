@@ -24,6 +24,7 @@
 
 CppPreprocessor::CppPreprocessor()
 {
+    mCancelFlag = nullptr;
 }
 
 void CppPreprocessor::clear()
@@ -34,8 +35,10 @@ void CppPreprocessor::clear()
     //Result across processings.
     //used by parser even preprocess finished
     mIncludesList.clear();
+    mSharedIncludesList.clear();
     mFileDefines.clear(); //dictionary to save defines for each headerfile;
     mScannedFiles.clear();
+    mIncludeGraph.clear();
 
     //option data for the parser
     //{ List of current project's include path }
@@ -54,11 +57,13 @@ void CppPreprocessor::clearTempResults()
     mFileName="";
     mBuffer.clear();
     mResult.clear();
+    mRootFileContents.clear();
     mCurrentIncludes=nullptr;
     mIncludes.clear(); // stack of files we've stepped into. last one is current file, first one is source file
     mBranchResults.clear();// stack of branch results (boolean). last one is current branch, first one is outermost branch
     mDefines.clear(); // working set, editable
     mProcessed.clear(); // dictionary to save filename already processed
+    mRecorders.clear();
 }
 
 void CppPreprocessor::addDefineByParts(const QString &name, const QString &args, const QString &value, bool hardCoded)
@@ -84,6 +89,7 @@ void CppPreprocessor::addDefineByParts(const QString &name, const QString &args,
         }
         defineMap->insert(define->name,define);
         mDefines.insert(name,define);
+        recordDefine(define);
     }
 }
 
@@ -155,6 +161,16 @@ void CppPreprocessor::setScanOptions(bool parseSystem, bool parseLocal)
     mParseLocal=parseLocal;
 }
 
+void CppPreprocessor::setCancelFlag(const QAtomicInt *flag)
+{
+    mCancelFlag = flag;
+}
+
+bool CppPreprocessor::isCancelled() const
+{
+    return mCancelFlag && mCancelFlag->loadAcquire();
+}
+
 void CppPreprocessor::preprocess(const QString &fileName)
 {
     clearTempResults();
@@ -167,6 +183,27 @@ void CppPreprocessor::preprocess(const QString &fileName)
     //    StringsToFile(mResult,"f:\\log.txt");
 }
 
+QStringList CppPreprocessor::preprocessLines(const QString &fileName, const QStringList &lines, int startLine)
+{
+    clearTempResults();
+    mFileName = fileName;
+    mDefines = mHardDefines;
+    PFileIncludes fileIncludes = getFileIncludesEntry(fileName);
+    if (fileIncludes) {
+        foreach (const QString& file, fileIncludes->includeFiles.keys()) {
+            addDefinesInFile(file);
+        }
+    }
+    addDefinesInFile(fileName);
+    QStringList result;
+    result.append(QString("#include %1:%2").arg(fileName).arg(startLine));
+    foreach (const QString& line, removeComments(lines)) {
+        result.append(expandMacros(line,1));
+    }
+    clearTempResults();
+    return result;
+}
+
 void CppPreprocessor::invalidDefinesInFile(const QString &fileName)
 {
     PDefineMap defineMap = mFileDefines.value(fileName,PDefineMap());
@@ -418,9 +455,19 @@ void CppPreprocessor::handleInclude(const QString &line, bool fromNext)
         return;
 
     PParsedFile file = mIncludes.back();
-    QString fileName;
+    QString fileName = resolveInclude(file->fileName, line, fromNext);
+    if (fileName.isEmpty()) {
+        recordInclude(fileName, line, fromNext, IncludeOutcome::Unresolved);
+        return;
+    }
+
+    openInclude(fileName, line, fromNext);
+}
+
+QString CppPreprocessor::resolveInclude(const QString &includer, const QString &line, bool fromNext) const
+{
     // Get full header file name
-    QString currentDir = includeTrailingPathDelimiter(extractFileDir(file->fileName));
+    QString currentDir = includeTrailingPathDelimiter(extractFileDir(includer));
     QStringList includes;
     QStringList projectIncludes;
     bool found=false;
@@ -446,17 +493,11 @@ void CppPreprocessor::handleInclude(const QString &line, bool fromNext)
         includes = mIncludePathList;
         projectIncludes = mProjectIncludePathList;
     }
-    fileName = getHeaderFilename(
-                file->fileName,
+    return getHeaderFilename(
+                includer,
                 line,
                 includes,
                 projectIncludes);
-
-    if (fileName.isEmpty())
-        return;
-
-    PFileIncludes oldCurrentIncludes = mCurrentIncludes;
-    openInclude(fileName);
 }
 
 void CppPreprocessor::handlePreprocessor(const QString &value)
@@ -497,6 +538,7 @@ void CppPreprocessor::handleUndefine(const QString &line)
     if (define) {
         //remove the define from defines set
         mDefines.remove(name);
+        recordUndefine(name);
         //remove the define form the file where it defines
         if (define->filename == mFileName) {
             PDefineMap defineMap = mFileDefines.value(mFileName);
@@ -655,15 +697,83 @@ void CppPreprocessor::removeGCCAttribute(const QString &line, QString &newLine,
     }
 }
 
-void CppPreprocessor::openInclude(const QString &fileName)
+// the directive of a preprocessor line, without the leading '#'
+static QString directiveOf(const QString& line)
+{
+    if (!line.startsWith('#'))
+        return QString();
+    return line.mid(1).trimmed();
+}
+
+// whether the (comments removed) header is protected by #pragma once or an include guard
+static bool hasIncludeGuard(const QStringList& buffer)
+{
+    int first = 0;
+    while (first<buffer.count() && buffer[first].isEmpty())
+        first++;
+    int last = buffer.count()-1;
+    while (last>first && buffer[last].isEmpty())
+        last--;
+    if (first>=last)
+        return false;
+    QString directive = directiveOf(buffer[first]);
+    QString guard;
+    if (directive.startsWith("ifndef")) {
+        guard = directive.mid(6).trimmed();
+    } else if (directive.startsWith("if")) {
+        QString expr = directive.mid(2);
+        expr.remove(' ');
+        if (expr.startsWith("!defined(") && expr.endsWith(')'))
+            guard = expr.mid(9,expr.length()-10);
+    }
+    if (guard.isEmpty()) {
+        foreach (const QString& line, buffer) {
+            directive = directiveOf(line);
+            if (directive.startsWith("pragma") && directive.mid(6).trimmed()=="once")
+                return true;
+        }
+        return false;
+    }
+    // the guard is defined right after the test
+    int i = first+1;
+    while (i<last && buffer[i].isEmpty())
+        i++;
+    directive = directiveOf(buffer[i]);
+    if (!directive.startsWith("define"))
+        return false;
+    QString name = directive.mid(6).trimmed();
+    int len = 0;
+    while (len<name.length() && (name[len].isLetterOrNumber() || name[len]=='_'))
+        len++;
+    if (name.left(len)!=guard)
+        return false;
+    // and the test ends at the last line
+    int level = 0;
+    for (int j=first;j<=last;j++) {
+        directive = directiveOf(buffer[j]);
+        if (directive.startsWith("if")) {
+            level++;
+        } else if (directive.startsWith("endif")) {
+            level--;
+            if (level==0 && j<last)
+                return false;
+        }
+    }
+    return level==0;
+}
+
+void CppPreprocessor::openInclude(const QString &fileName, const QString& directive, bool fromNext)
 {
+    int fileId = FileIdTable::idOf(fileName);
     if (mIncludes.size()>0) {
         PParsedFile topFile = mIncludes.front();
-        if (topFile->fileIncludes->includeFiles.contains(fileName)) {
+        if (topFile->fileIncludes->includeFileIds.contains(fileId)) {
+            recordInclude(fileName, directive, fromNext, IncludeOutcome::Skipped);
             return; //already included
         }
         for (PParsedFile& parsedFile:mIncludes) {
             parsedFile->fileIncludes->includeFiles.insert(fileName,false);
+            parsedFile->fileIncludes->includeFileIds.insert(fileId);
         }
         // Backup old position if we're entering a new file
         PParsedFile innerMostFile = mIncludes.back();
@@ -696,7 +806,7 @@ void CppPreprocessor::openInclude(const QString &fileName)
 
     // Keep track of files we include here
     // Only create new items for files we have NOT scanned yet
-    mCurrentIncludes = getFileIncludesEntry(fileName);
+    mCurrentIncludes = getWritableFileIncludesEntry(fileName);
     if (!mCurrentIncludes) {
         // do NOT create a new item for a file that's already in the list
         mCurrentIncludes = std::make_shared<FileIncludes>();
@@ -706,6 +816,8 @@ void CppPreprocessor::openInclude(const QString &fileName)
 
     parsedFile->fileIncludes = mCurrentIncludes;
 
+    QByteArray contentHash; // only calculated for headers
+    PPreprocessedHeader cachedHeader;
     // Don't parse stuff we have already parsed
     if (!mScannedFiles.contains(fileName)) {
         // Parse ONCE
@@ -713,16 +825,24 @@ void CppPreprocessor::openInclude(const QString &fileName)
         mScannedFiles.insert(fileName);
 
         // Only load up the file if we are allowed to parse it
-        bool isSystemFile = isSystemHeaderFile(fileName, mIncludePaths) || isSystemHeaderFile(fileName, mProjectIncludePaths);
-        if ((mParseSystem && isSystemFile) || (mParseLocal && !isSystemFile)) {
-            QStringList bufferedText;
-            if (mOnGetFileStream && mOnGetFileStream(fileName,bufferedText)) {
-                parsedFile->buffer  = bufferedText;
-            } else {
-                parsedFile->buffer = readFileToLines(fileName);
+        if (shouldLoadFile(fileName)) {
+            parsedFile->buffer = loadFile(fileName);
+            if (!mIncludes.isEmpty()) {
+                contentHash = PreprocessedHeaderCache::contentHash(parsedFile->buffer);
+                cachedHeader = PreprocessedHeaderCache::find(fileName, contentHash);
             }
         }
+        recordInclude(fileName, directive, fromNext, IncludeOutcome::Opened, contentHash);
     } else {
+        foreach (const PParsedFile& file, mIncludes) {
+            //defines got from a file that is still being preprocessed are incomplete
+            if (file->fileName == fileName) {
+                foreach (const PHeaderRecorder& recorder, mRecorders)
+                    recorder->valid = false;
+                break;
+            }
+        }
+        recordInclude(fileName, directive, fromNext, IncludeOutcome::Scanned);
         //add defines of already parsed including headers;
         addDefinesInFile(fileName);
         PFileIncludes fileIncludes = getFileIncludesEntry(fileName);
@@ -730,14 +850,21 @@ void CppPreprocessor::openInclude(const QString &fileName)
             foreach (const QString& incFile,fileIncludes->includeFiles.keys()) {
                 file->fileIncludes->includeFiles.insert(incFile,false);
             }
+            file->fileIncludes->includeFileIds.unite(fileIncludes->includeFileIds);
         }
     }
+    bool replayed = false;
+    if (cachedHeader && replayHeader(cachedHeader)) {
+        parsedFile->buffer.clear();
+        replayed = true;
+    }
     mIncludes.append(parsedFile);
 
     // Process it
     mIndex = parsedFile->index;
     mFileName = parsedFile->fileName;
-    parsedFile->buffer = removeComments(parsedFile->buffer);
+    if (!replayed)
+        parsedFile->buffer = removeComments(parsedFile->buffer);
     mBuffer = parsedFile->buffer;
 
 //    for (int i=0;i<mBuffer.count();i++) {
@@ -751,6 +878,13 @@ void CppPreprocessor::openInclude(const QString &fileName)
     } else {
       mResult.append(includeLine);
     }
+
+    if (replayed) {
+        mResult.append(cachedHeader->result);
+    } else if (!contentHash.isEmpty() && hasIncludeGuard(mBuffer)) {
+        //only headers that are meant to be included once are worth caching
+        startRecording(fileName, contentHash);
+    }
 }
 
 
@@ -758,6 +892,10 @@ void CppPreprocessor::closeInclude()
 {
     if (mIncludes.isEmpty())
         return;
+    mIncludeGraph.setIncludes(mIncludes.back()->fileName,
+                              mIncludes.back()->fileIncludes->includeFiles.keys());
+    if (!mRecorders.isEmpty() && mRecorders.last()->depth == mIncludes.count())
+        finishRecording();
     mIncludes.pop_back();
 
     if (mIncludes.isEmpty())
@@ -784,6 +922,246 @@ void CppPreprocessor::closeInclude()
                 .arg(parsedFile->index+1));
 }
 
+bool CppPreprocessor::shouldLoadFile(const QString &fileName) const
+{
+    bool isSystemFile = isSystemHeaderFile(fileName, mIncludePaths) || isSystemHeaderFile(fileName, mProjectIncludePaths);
+    return (mParseSystem && isSystemFile) || (mParseLocal && !isSystemFile);
+}
+
+QStringList CppPreprocessor::loadFile(const QString &fileName)
+{
+    QStringList bufferedText;
+    if (mOnGetFileStream && mOnGetFileStream(fileName,bufferedText)) {
+        if (mIncludes.isEmpty())
+            mRootFileContents = bufferedText;
+        return bufferedText;
+    }
+    return readFileToLines(fileName);
+}
+
+void CppPreprocessor::recordLookup(const QString &name, const PDefine &define)
+{
+    foreach (const PHeaderRecorder& recorder, mRecorders) {
+        if (recorder->lookedUp.contains(name))
+            continue;
+        recorder->lookedUp.insert(name);
+        PreprocessEvent event{};
+        event.type = PreprocessEventType::Lookup;
+        event.name = name;
+        event.define = define;
+        recorder->header->events.append(event);
+    }
+}
+
+void CppPreprocessor::recordDefine(const PDefine &define)
+{
+    foreach (const PHeaderRecorder& recorder, mRecorders) {
+        //later lookups of it are decided by the recorded events
+        recorder->lookedUp.insert(define->name);
+        PreprocessEvent event{};
+        event.type = PreprocessEventType::Define;
+        event.name = define->name;
+        event.define = define;
+        recorder->header->events.append(event);
+    }
+}
+
+void CppPreprocessor::recordUndefine(const QString &name)
+{
+    foreach (const PHeaderRecorder& recorder, mRecorders) {
+        recorder->lookedUp.insert(name);
+        PreprocessEvent event{};
+        event.type = PreprocessEventType::Undefine;
+        event.name = name;
+        recorder->header->events.append(event);
+    }
+}
+
+void CppPreprocessor::recordInclude(const QString &fileName, const QString &directive, bool fromNext,
+                                    IncludeOutcome outcome, const QByteArray &contentHash)
+{
+    if (mRecorders.isEmpty())
+        return;
+    PreprocessEvent event{};
+    event.type = PreprocessEventType::Include;
+    event.name = fileName;
+    event.includer = mIncludes.back()->fileName;
+    event.directive = directive;
+    event.fromNext = fromNext;
+    event.outcome = outcome;
+    event.contentHash = contentHash;
+    foreach (const PHeaderRecorder& recorder, mRecorders) {
+        //defines of the scanned file may change any macro
+        if (outcome == IncludeOutcome::Scanned)
+            recorder->lookedUp.clear();
+        recorder->header->events.append(event);
+    }
+}
+
+void CppPreprocessor::startRecording(const QString &fileName, const QByteArray &contentHash)
+{
+    PHeaderRecorder recorder = std::make_shared<HeaderRecorder>();
+    recorder->header = std::make_shared<PreprocessedHeader>();
+    recorder->header->fileName = fileName;
+    recorder->header->contentHash = contentHash;
+    recorder->depth = mIncludes.count();
+    recorder->resultStart = mResult.count();
+    recorder->branches = mBranchResults.count();
+    recorder->valid = true;
+    mRecorders.append(recorder);
+}
+
+void CppPreprocessor::finishRecording()
+{
+    PHeaderRecorder recorder = mRecorders.takeLast();
+    //an unbalanced #endif in the header changes branches of the including file
+    if (!recorder->valid || mBranchResults.count() < recorder->branches)
+        return;
+    PPreprocessedHeader header = recorder->header;
+    header->result = mResult.mid(recorder->resultStart);
+    header->files.append(fileRecord(header->fileName));
+    foreach (const PreprocessEvent& event, header->events) {
+        if (event.type == PreprocessEventType::Include
+                && event.outcome == IncludeOutcome::Opened)
+            header->files.append(fileRecord(event.name));
+    }
+    PreprocessedHeaderCache::insert(header);
+}
+
+PreprocessedFileRecord CppPreprocessor::fileRecord(const QString &fileName) const
+{
+    PreprocessedFileRecord record;
+    record.fileName = fileName;
+    PFileIncludes fileIncludes = mIncludesList.value(fileName);
+    if (fileIncludes) {
+        record.includeFiles = fileIncludes->includeFiles;
+        record.includeFileIds = fileIncludes->includeFileIds;
+        record.directIncludes = fileIncludes->directIncludes;
+    }
+    PDefineMap defines = mFileDefines.value(fileName);
+    if (defines)
+        record.defines = std::make_shared<DefineMap>(*defines);
+    return record;
+}
+
+bool CppPreprocessor::replayHeader(const PPreprocessedHeader &header)
+{
+    DefineMap oldDefines = mDefines;
+    QSet<QString> oldProcessed = mProcessed;
+    const FileIdSet& topIncludes = mIncludes.front()->fileIncludes->includeFileIds;
+    QSet<QString> includedFiles; // files included by the header
+    bool ok = true;
+    foreach (const PreprocessEvent& event, header->events) {
+        switch (event.type) {
+        case PreprocessEventType::Lookup: {
+            PDefine define = mDefines.value(event.name,PDefine());
+            if (define != event.define
+                    && (!define || !event.define
+                        || define->args != event.define->args
+                        || define->value != event.define->value))
+                ok = false;
+            break;
+        }
+        case PreprocessEventType::Define:
+            mDefines.insert(event.name,event.define);
+            break;
+        case PreprocessEventType::Undefine:
+            mDefines.remove(event.name);
+            break;
+        case PreprocessEventType::Include: {
+            if (resolveInclude(event.includer, event.directive, event.fromNext) != event.name) {
+                ok = false;
+                break;
+            }
+            if (event.outcome == IncludeOutcome::Unresolved)
+                break;
+            IncludeOutcome outcome;
+            if (topIncludes.contains(FileIdTable::idOf(event.name))
+                    || includedFiles.contains(event.name))
+                outcome = IncludeOutcome::Skipped;
+            else if (mScannedFiles.contains(event.name))
+                outcome = IncludeOutcome::Scanned;
+            else
+                outcome = IncludeOutcome::Opened;
+            if (outcome != event.outcome) {
+                ok = false;
+                break;
+            }
+            if (outcome == IncludeOutcome::Scanned) {
+                includedFiles.insert(event.name);
+                PFileIncludes fileIncludes = getFileIncludesEntry(event.name);
+                if (fileIncludes) {
+                    foreach (const QString& file, fileIncludes->includeFiles.keys())
+                        includedFiles.insert(file);
+                }
+                addDefinesInFile(event.name);
+            } else if (outcome == IncludeOutcome::Opened) {
+                includedFiles.insert(event.name);
+                QByteArray contentHash;
+                if (shouldLoadFile(event.name))
+                    contentHash = PreprocessedHeaderCache::contentHash(loadFile(event.name));
+                if (contentHash != event.contentHash)
+                    ok = false;
+            }
+            break;
+        }
+        }
+        if (!ok)
+            break;
+    }
+    if (!ok) {
+        mDefines = oldDefines;
+        mProcessed = oldProcessed;
+        return false;
+    }
+
+    foreach (const PreprocessedFileRecord& record, header->files) {
+        PFileIncludes fileIncludes = getWritableFileIncludesEntry(record.fileName);
+        if (!fileIncludes) {
+            fileIncludes = std::make_shared<FileIncludes>();
+            fileIncludes->baseFile = record.fileName;
+            mIncludesList.insert(record.fileName,fileIncludes);
+        }
+        for (auto it=record.includeFiles.constBegin();it!=record.includeFiles.constEnd();++it)
+            fileIncludes->includeFiles.insert(it.key(),it.value());
+        fileIncludes->includeFileIds.unite(record.includeFileIds);
+        fileIncludes->directIncludes.append(record.directIncludes);
+        if (record.defines)
+            mFileDefines.insert(record.fileName,std::make_shared<DefineMap>(*record.defines));
+        mScannedFiles.insert(record.fileName);
+        //the header itself is added when it's closed
+        if (record.fileName != header->fileName)
+            mIncludeGraph.setIncludes(record.fileName, fileIncludes->includeFiles.keys());
+    }
+    foreach (const PParsedFile& file, mIncludes) {
+        foreach (const QString& includedFile, includedFiles) {
+            file->fileIncludes->includeFiles.insert(includedFile,false);
+            file->fileIncludes->includeFileIds.insert(FileIdTable::idOf(includedFile));
+        }
+    }
+
+    //the header's events become part of the headers being recorded
+    if (!mRecorders.isEmpty()) {
+        bool valid = true;
+        foreach (const PreprocessEvent& event, header->events) {
+            if (event.type != PreprocessEventType::Include
+                    || event.outcome != IncludeOutcome::Scanned)
+                continue;
+            foreach (const PParsedFile& file, mIncludes) {
+                if (file->fileName == event.name)
+                    valid = false;
+            }
+        }
+        foreach (const PHeaderRecorder& recorder, mRecorders) {
+            recorder->header->events.append(header->events);
+            recorder->lookedUp.clear();
+            if (!valid)
+                recorder->valid = false;
+        }
+    }
+    return true;
+}
+
 void CppPreprocessor::addDefinesInFile(const QString &fileName)
 {
     if (mProcessed.contains(fileName))
@@ -1057,6 +1435,9 @@ void CppPreprocessor::preprocessBuffer()
     while (mIncludes.count() > 0) {
         QString s;
         do {
+            // leave the include stack as is, so no half-done header is recorded
+            if (isCancelled())
+                return;
             s = getNextPreprocessor();
             if (s.startsWith('#')) {
                 s = s.mid(1).trimmed(); // remove #
@@ -1782,6 +2163,11 @@ void CppPreprocessor::setOnGetFileStream(const GetFileStreamCallBack &newOnGetFi
     mOnGetFileStream = newOnGetFileStream;
 }
 
+const GetFileStreamCallBack &CppPreprocessor::onGetFileStream() const
+{
+    return mOnGetFileStream;
+}
+
 const QList<QString> &CppPreprocessor::projectIncludePathList() const
 {
     return mProjectIncludePathList;
@@ -1797,6 +2183,58 @@ const DefineMap &CppPreprocessor::hardDefines() const
     return mHardDefines;
 }
 
+const QHash<QString, PDefineMap> &CppPreprocessor::fileDefines() const
+{
+    return mFileDefines;
+}
+
+void CppPreprocessor::addFileDefines(const QString &fileName, const PDefineMap &defines)
+{
+    mFileDefines.insert(fileName,defines);
+}
+
+void CppPreprocessor::assignStates(const CppPreprocessor &other)
+{
+    clearTempResults();
+    mIncludesList = other.mIncludesList;
+    mSharedIncludesList = other.mIncludesList;
+    mFileDefines = other.mFileDefines;
+    mScannedFiles = other.mScannedFiles;
+    mIncludeGraph = other.mIncludeGraph;
+    mHardDefines = other.mHardDefines;
+    mProjectIncludePaths = other.mProjectIncludePaths;
+    mIncludePathList = other.mIncludePathList;
+    mProjectIncludePathList = other.mProjectIncludePathList;
+    mIncludePaths = other.mIncludePaths;
+    mOnGetFileStream = other.mOnGetFileStream;
+}
+
+PFileIncludes CppPreprocessor::getWritableFileIncludesEntry(const QString &fileName)
+{
+    PFileIncludes fileIncludes = mIncludesList.value(fileName);
+    if (fileIncludes && fileIncludes == mSharedIncludesList.value(fileName)) {
+        // the other preprocessor (and its parser) may be using it
+        fileIncludes = std::make_shared<FileIncludes>(*fileIncludes);
+        mIncludesList.insert(fileName,fileIncludes);
+    }
+    return fileIncludes;
+}
+
+void CppPreprocessor::addScannedFiles(const CppPreprocessor &other, const QSet<QString> &files)
+{
+    foreach (const QString& file, files) {
+        mScannedFiles.insert(file);
+        PFileIncludes fileIncludes = other.mIncludesList.value(file);
+        if (fileIncludes)
+            mIncludesList.insert(file,fileIncludes);
+        if (other.mIncludeGraph.contains(file))
+            mIncludeGraph.setIncludes(file, other.mIncludeGraph.includes(file).values());
+        PDefineMap defineMap = other.mFileDefines.value(file);
+        if (defineMap)
+            mFileDefines.insert(file,defineMap);
+    }
+}
+
 const QSet<QString> &CppPreprocessor::projectIncludePaths()
 {
     return mProjectIncludePaths;
@@ -1812,6 +2250,16 @@ QSet<QString> &CppPreprocessor::scannedFiles()
     return mScannedFiles;
 }
 
+IncludeGraph &CppPreprocessor::includeGraph()
+{
+    return mIncludeGraph;
+}
+
+const IncludeGraph &CppPreprocessor::includeGraph() const
+{
+    return mIncludeGraph;
+}
+
 QHash<QString, PFileIncludes> &CppPreprocessor::includesList()
 {
     return mIncludesList;
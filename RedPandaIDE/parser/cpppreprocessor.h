@@ -17,9 +17,11 @@
 #ifndef CPPPREPROCESSOR_H
 #define CPPPREPROCESSOR_H
 
+#include <QAtomicInt>
 #include <QObject>
 #include <QTextStream>
 #include "parserutils.h"
+#include "preprocessedheadercache.h"
 
 #define MAX_DEFINE_EXPAND_DEPTH 20
 enum class DefineArgTokenType{
@@ -45,6 +47,17 @@ struct ParsedFile {
 };
 using PParsedFile = std::shared_ptr<ParsedFile>;
 
+// records the preprocessing of a header, to save it in the PreprocessedHeaderCache
+struct HeaderRecorder {
+    PPreprocessedHeader header;
+    int depth; // count of mIncludes when the header is opened
+    int resultStart; // index of the first result line of the header
+    int branches; // count of branch results when the header is opened
+    bool valid;
+    QSet<QString> lookedUp; // macros whose lookup needn't to be recorded again
+};
+using PHeaderRecorder = std::shared_ptr<HeaderRecorder>;
+
 class CppPreprocessor
 {
     enum class ContentType {
@@ -70,7 +83,19 @@ public:
     void getDefineParts(const QString& input, QString &name, QString &args, QString &value);
     void addHardDefineByLine(const QString& line);
     void setScanOptions(bool parseSystem, bool parseLocal);
+    // preprocess() stops early if the flag is set, the results are incomplete then
+    void setCancelFlag(const QAtomicInt* flag);
+    bool isCancelled() const;
     void preprocess(const QString& fileName);
+    /**
+     * @brief preprocess some lines of a scanned file, using defines visible in the file.
+     * The lines shouldn't contain preprocessor directives.
+     * @param fileName
+     * @param lines
+     * @param startLine line number of the first line in the file
+     * @return
+     */
+    QStringList preprocessLines(const QString& fileName, const QStringList& lines, int startLine);
 
     void dumpDefinesTo(const QString& fileName) const;
     void dumpIncludesListTo(const QString& fileName) const;
@@ -83,6 +108,10 @@ public:
     const QStringList& result() const{
         return mResult;
     };
+    // contents of the file being preprocessed, if it's got from the file stream callback
+    const QStringList& rootFileContents() const{
+        return mRootFileContents;
+    }
 
     QHash<QString, PFileIncludes> &includesList();
 
@@ -90,16 +119,34 @@ public:
 
     QSet<QString> &scannedFiles();
 
+    IncludeGraph &includeGraph();
+
+    const IncludeGraph &includeGraph() const;
+
     const QSet<QString> &includePaths();
 
     const QSet<QString> &projectIncludePaths();
 
     const DefineMap &hardDefines() const;
 
+    const QHash<QString, PDefineMap> &fileDefines() const;
+    void addFileDefines(const QString& fileName, const PDefineMap& defines);
+
+    /**
+     * @brief copy paths, hard defines and results of scanned files from another preprocessor,
+     * so files can be preprocessed independently (in another thread) with the same states
+     */
+    void assignStates(const CppPreprocessor& other);
+    /**
+     * @brief add results of the files scanned by another preprocessor
+     */
+    void addScannedFiles(const CppPreprocessor& other, const QSet<QString>& files);
+
     const QList<QString> &includePathList() const;
 
     const QList<QString> &projectIncludePathList() const;
     void setOnGetFileStream(const GetFileStreamCallBack &newOnGetFileStream);
+    const GetFileStreamCallBack &onGetFileStream() const;
 
     static QList<PDefineArgToken> tokenizeValue(const QString& value);
 
@@ -111,21 +158,42 @@ private:
     void handleBranch(const QString& line);
     void handleDefine(const QString& line);
     void handleInclude(const QString& line, bool fromNext=false);
+    QString resolveInclude(const QString& includer, const QString& line, bool fromNext) const;
     void handlePreprocessor(const QString& value);
     void handleUndefine(const QString& line);
     QString expandMacros(const QString& line, int depth);
     void expandMacro(const QString& line, QString& newLine, QString& word, int& i, int depth);
     QString removeGCCAttributes(const QString& line);
     void removeGCCAttribute(const QString&line, QString& newLine, int &i, const QString& word);
-    PDefine getDefine(const QString& name) const{
-        return mDefines.value(name,PDefine());
+    PDefine getDefine(const QString& name) {
+        PDefine define = mDefines.value(name,PDefine());
+        if (!mRecorders.isEmpty())
+            recordLookup(name,define);
+        return define;
     }
     // current file stuff
     PParsedFile getInclude(int index) const {
         return mIncludes[index];
     }
-    void openInclude(const QString& fileName);
+    void openInclude(const QString& fileName, const QString& directive=QString(), bool fromNext=false);
     void closeInclude();
+    bool shouldLoadFile(const QString& fileName) const;
+    QStringList loadFile(const QString& fileName);
+
+    // preprocessed header cache stuff
+    void recordLookup(const QString& name, const PDefine& define);
+    void recordDefine(const PDefine& define);
+    void recordUndefine(const QString& name);
+    void recordInclude(const QString& fileName, const QString& directive, bool fromNext,
+                       IncludeOutcome outcome, const QByteArray& contentHash=QByteArray());
+    void startRecording(const QString& fileName, const QByteArray& contentHash);
+    void finishRecording();
+    /**
+     * @brief apply the cached result of the header being opened
+     * @return false if the result can't be used in the current state, and nothing is changed
+     */
+    bool replayHeader(const PPreprocessedHeader& header);
+    PreprocessedFileRecord fileRecord(const QString& fileName) const;
 
     // branch stuff
     bool getCurrentBranch(){
@@ -145,6 +213,8 @@ private:
     PFileIncludes getFileIncludesEntry(const QString& fileName){
         return mIncludesList.value(fileName,PFileIncludes());
     }
+    // entry to be changed, entries shared with the preprocessor in assignStates() are copied first
+    PFileIncludes getWritableFileIncludesEntry(const QString& fileName);
     void addDefinesInFile(const QString& fileName);
     void addDefineByParts(const QString& name, const QString& args,
                           const QString& value, bool hardCoded);
@@ -223,19 +293,23 @@ private:
     QString mFileName;
     QStringList mBuffer;
     QStringList mResult;
+    QStringList mRootFileContents;
     PFileIncludes mCurrentIncludes;
     int mPreProcIndex;    
     QList<PParsedFile> mIncludes; // stack of files we've stepped into. last one is current file, first one is source file
     QList<bool> mBranchResults;// stack of branch results (boolean). last one is current branch, first one is outermost branch
     DefineMap mDefines; // working set, editable
     QSet<QString> mProcessed; // dictionary to save filename already processed
+    QList<PHeaderRecorder> mRecorders; // stack of headers being recorded, the last one is innermost
 
 
     //Result across processings.
     //used by parser even preprocess finished
     QHash<QString,PFileIncludes> mIncludesList;
+    QHash<QString,PFileIncludes> mSharedIncludesList; // entries got from assignStates(), owned by the other preprocessor
     QHash<QString, PDefineMap> mFileDefines; //dictionary to save defines for each headerfile;
     QSet<QString> mScannedFiles;
+    IncludeGraph mIncludeGraph;
 
     //option data for the parser
     //{ List of current project's include path }
@@ -249,6 +323,7 @@ private:
 
     bool mParseSystem;
     bool mParseLocal;
+    const QAtomicInt* mCancelFlag;
 
     GetFileStreamCallBack mOnGetFileStream;
 };
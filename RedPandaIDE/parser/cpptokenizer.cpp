@@ -22,7 +22,7 @@
 
 CppTokenizer::CppTokenizer()
 {
-
+    mCancelFlag = nullptr;
 }
 
 void CppTokenizer::clear()
@@ -57,6 +57,10 @@ void CppTokenizer::tokenize(const QStringList &buffer)
 
     TokenType tokenType;
     while (true) {
+        if (mCancelFlag && mCancelFlag->loadAcquire()) {
+            clear();
+            return;
+        }
         mLastToken = s;
         s = getNextToken(&tokenType);
         simplify(s);
@@ -76,14 +80,25 @@ void CppTokenizer::tokenize(const QStringList &buffer)
     }
 }
 
+void CppTokenizer::setCancelFlag(const QAtomicInt *flag)
+{
+    mCancelFlag = flag;
+}
+
+void CppTokenizer::swap(CppTokenizer &other)
+{
+    mTokenList.swap(other.mTokenList);
+    mLambdas.swap(other.mLambdas);
+}
+
 void CppTokenizer::dumpTokens(const QString &fileName)
 {
     QFile file(fileName);
 
     if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
         QTextStream stream(&file);
-        foreach (const PToken& token,mTokenList) {
-            stream<<QString("%1,%2,%3").arg(token->line).arg(token->text).arg(token->matchIndex)
+        foreach (const Token& token,mTokenList) {
+            stream<<QString("%1,%2,%3").arg(token.line).arg(token.text).arg(token.matchIndex)
 #if QT_VERSION >= QT_VERSION_CHECK(5,15,0)
                  <<Qt::endl;
 #else
@@ -95,49 +110,50 @@ void CppTokenizer::dumpTokens(const QString &fileName)
 
 void CppTokenizer::addToken(const QString &sText, int iLine, TokenType tokenType)
 {
-    PToken token = std::make_shared<Token>();
-    token->text = sText;
-    token->line = iLine;
+    Token token{};
+    token.text = sText;
+    token.line = iLine;
+    token.keyword = CppKeywords.value(sText,KeywordType::NotKeyword);
 #ifdef Q_DEBUG
-    token->matchIndex = 1000000000;
+    token.matchIndex = 1000000000;
 #endif
     switch(tokenType) {
     case TokenType::LeftBrace:
-        token->matchIndex=-1;
+        token.matchIndex=-1;
         mUnmatchedBraces.push_back(mTokenList.count());
         break;
     case TokenType::RightBrace:
         if (mUnmatchedBraces.isEmpty()) {
-            token->matchIndex=-1;
+            token.matchIndex=-1;
         } else {
-            token->matchIndex = mUnmatchedBraces.last();
-            mTokenList[token->matchIndex]->matchIndex=mTokenList.count();
+            token.matchIndex = mUnmatchedBraces.last();
+            mTokenList[token.matchIndex].matchIndex=mTokenList.count();
             mUnmatchedBraces.pop_back();
         }
         break;
     case TokenType::LeftBracket:
-        token->matchIndex=-1;
+        token.matchIndex=-1;
         mUnmatchedBrackets.push_back(mTokenList.count());
         break;
     case TokenType::RightBracket:
         if (mUnmatchedBrackets.isEmpty()) {
-            token->matchIndex=-1;
+            token.matchIndex=-1;
         } else {
-            token->matchIndex = mUnmatchedBrackets.last();
-            mTokenList[token->matchIndex]->matchIndex=mTokenList.count();
+            token.matchIndex = mUnmatchedBrackets.last();
+            mTokenList[token.matchIndex].matchIndex=mTokenList.count();
             mUnmatchedBrackets.pop_back();
         }
         break;
     case TokenType::LeftParenthesis:
-        token->matchIndex=-1;
+        token.matchIndex=-1;
         mUnmatchedParenthesis.push_back(mTokenList.count());
         break;
     case TokenType::RightParenthesis:
         if (mUnmatchedParenthesis.isEmpty()) {
-            token->matchIndex=-1;
+            token.matchIndex=-1;
         } else {
-            token->matchIndex = mUnmatchedParenthesis.last();
-            mTokenList[token->matchIndex]->matchIndex=mTokenList.count();
+            token.matchIndex = mUnmatchedParenthesis.last();
+            mTokenList[token.matchIndex].matchIndex=mTokenList.count();
             mUnmatchedParenthesis.pop_back();
         }
         break;
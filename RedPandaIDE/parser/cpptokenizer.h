@@ -17,6 +17,7 @@
 #ifndef CPPTOKENIZER_H
 #define CPPTOKENIZER_H
 
+#include <QAtomicInt>
 #include <QObject>
 #include "parserutils.h"
 
@@ -39,18 +40,23 @@ public:
       QString text;
       int line;
       int matchIndex;
+      KeywordType keyword; // classified when tokenized, NotKeyword for other tokens
     };
-    using PToken = std::shared_ptr<Token>;
-    using TokenList = QVector<PToken>;
+    using TokenList = QVector<Token>;
     explicit CppTokenizer();
     CppTokenizer(const CppTokenizer&)=delete;
     CppTokenizer& operator=(const CppTokenizer&)=delete;
 
     void clear();
+    // stops and returns an empty token list, if the flag is set while tokenizing
+    void setCancelFlag(const QAtomicInt* flag);
     void tokenize(const QStringList& buffer);
+    // exchange tokenize results with another tokenizer
+    void swap(CppTokenizer& other);
     void dumpTokens(const QString& fileName);
-    const PToken& operator[](int i) const {
-        return mTokenList[i];
+    // tokens are stored in place, the pointer is valid until the next tokenize()/clear()
+    const Token* operator[](int i) const {
+        return mTokenList.constData()+i;
     }
     int tokenCount() const {
         return mTokenList.count();
@@ -73,7 +79,6 @@ private:
     void addToken(const QString& sText, int iLine, TokenType tokenType);
     void advance();
     void countLines();
-    PToken getToken(int index);
 
     QString getForInit();
     QString getNextToken(
@@ -169,6 +174,7 @@ private:
     QVector<int> mUnmatchedBraces; // stack of indices for unmatched '{'
     QVector<int> mUnmatchedBrackets; // stack of indices for unmatched '['
     QVector<int> mUnmatchedParenthesis;// stack of indices for unmatched '('
+    const QAtomicInt* mCancelFlag;
 };
 
 using PCppTokenizer = std::shared_ptr<CppTokenizer>;
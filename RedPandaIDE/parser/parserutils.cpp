@@ -565,6 +565,174 @@ void CppScopes::clear()
     mScopes.clear();
 }
 
+const QVector<PCppScope> &CppScopes::scopes() const
+{
+    return mScopes;
+}
+
+void CppScopes::setScopes(const QVector<PCppScope> &scopes)
+{
+    mScopes = scopes;
+}
+
+QMutex FileIdTable::mMutex;
+QHash<QString,int> FileIdTable::mIds;
+QStringList FileIdTable::mFileNames;
+
+int FileIdTable::idOf(const QString &fileName)
+{
+    if (fileName.isEmpty())
+        return -1;
+    QMutexLocker locker(&mMutex);
+    int id = mIds.value(fileName,-1);
+    if (id<0) {
+        id = mFileNames.count();
+        mFileNames.append(fileName);
+        mIds.insert(fileName,id);
+    }
+    return id;
+}
+
+int FileIdTable::findId(const QString &fileName)
+{
+    if (fileName.isEmpty())
+        return -1;
+    QMutexLocker locker(&mMutex);
+    return mIds.value(fileName,-1);
+}
+
+QString FileIdTable::fileName(int id)
+{
+    QMutexLocker locker(&mMutex);
+    return mFileNames.value(id);
+}
+
+QString StringPool::intern(const QString &s)
+{
+    auto it = mStrings.constFind(s);
+    if (it != mStrings.constEnd())
+        return *it;
+    mStrings.insert(s);
+    return s;
+}
+
+void StringPool::squeeze()
+{
+    for (auto it=mStrings.begin();it!=mStrings.end();) {
+        if (it->isDetached())
+            it = mStrings.erase(it);
+        else
+            ++it;
+    }
+}
+
+void StringPool::clear()
+{
+    mStrings.clear();
+}
+
+int StringPool::count() const
+{
+    return mStrings.count();
+}
+
+void IncludeGraph::setIncludes(const QString &fileName, const QList<QString> &includes)
+{
+    QSet<QString> newIncludes;
+    foreach (const QString& file, includes) {
+        if (file != fileName)
+            newIncludes.insert(file);
+    }
+    QSet<QString> oldIncludes = mIncludes.value(fileName);
+    if (oldIncludes == newIncludes && mIncludes.contains(fileName))
+        return;
+    foreach (const QString& file, oldIncludes) {
+        if (newIncludes.contains(file))
+            continue;
+        auto it = mIncludedBy.find(file);
+        if (it != mIncludedBy.end()) {
+            it.value().remove(fileName);
+            if (it.value().isEmpty())
+                mIncludedBy.erase(it);
+        }
+    }
+    foreach (const QString& file, newIncludes) {
+        if (!oldIncludes.contains(file))
+            mIncludedBy[file].insert(fileName);
+    }
+    mIncludes.insert(fileName,newIncludes);
+}
+
+bool IncludeGraph::contains(const QString &fileName) const
+{
+    return mIncludes.contains(fileName);
+}
+
+QSet<QString> IncludeGraph::includes(const QString &fileName) const
+{
+    return mIncludes.value(fileName);
+}
+
+QSet<QString> IncludeGraph::includedBy(const QString &fileName) const
+{
+    return mIncludedBy.value(fileName);
+}
+
+void IncludeGraph::clear()
+{
+    mIncludes.clear();
+    mIncludedBy.clear();
+}
+
+QStringList IncludeGraph::sortByIncludeRelations(const QSet<QString> &files) const
+{
+    // Kahn's algorithm. the count is -1 when the file is sorted
+    QHash<QString,int> includedCount; // how many unsorted files in the set include the file
+    foreach (const QString& file, files)
+        includedCount.insert(file,0);
+    foreach (const QString& file, files) {
+        foreach (const QString& includedFile, mIncludes.value(file)) {
+            auto it = includedCount.find(includedFile);
+            if (it != includedCount.end())
+                it.value()++;
+        }
+    }
+    QStringList queue;
+    for (auto it=includedCount.constBegin();it!=includedCount.constEnd();++it) {
+        if (it.value()==0)
+            queue.append(it.key());
+    }
+    QStringList result;
+    int head = 0;
+    while (result.count() < files.count()) {
+        if (head >= queue.count()) {
+            // the files left are in include cycles
+            QString next;
+            int minCount = -1;
+            for (auto it=includedCount.constBegin();it!=includedCount.constEnd();++it) {
+                if (it.value()>0 && (minCount<0 || it.value()<minCount)) {
+                    next = it.key();
+                    minCount = it.value();
+                }
+            }
+            includedCount[next] = 0;
+            queue.append(next);
+        }
+        QString file = queue[head++];
+        result.append(file);
+        includedCount[file] = -1;
+        foreach (const QString& includedFile, mIncludes.value(file)) {
+            auto it = includedCount.find(includedFile);
+            if (it != includedCount.end() && it.value()>0) {
+                it.value()--;
+                if (it.value()==0)
+                    queue.append(includedFile);
+            }
+        }
+    }
+    return result;
+}
+
 MemberOperatorType getOperatorType(const QString &phrase, int index)
 {
     if (index>=phrase.length())
@@ -675,6 +843,40 @@ bool isMemberOperator(QString token)
 }
 
 
+bool FileSemanticTokens::kindAt(int line, int column, const QString &lineText, StatementKind &kind) const
+{
+    if (line<1 || line>lines.count() || lines[line-1]!=lineText)
+        return false;
+    foreach (const SemanticToken& token, tokens[line-1]) {
+        if (token.column == column) {
+            kind = token.kind;
+            return true;
+        }
+    }
+    return false;
+}
+
+QVector<SymbolReference> FileReferences::referencesOf(const PStatement &statement) const
+{
+    QVector<SymbolReference> result;
+    // statements declared in the same line are told apart by the name
+    foreach (const SymbolReference& reference, references.value(referenceKey(statement))) {
+        if (lines[reference.line-1].mid(reference.column-1,reference.length) == statement->command)
+            result.append(reference);
+    }
+    return result;
+}
+
+QString FileReferences::referenceKey(const PStatement &statement)
+{
+    return referenceKey(statement->fileName, statement->line);
+}
+
+QString FileReferences::referenceKey(const QString &fileName, int line)
+{
+    return QString("%1\n%2").arg(fileName, QString::number(line));
+}
+
 StatementKind getKindOfStatement(const PStatement& statement)
 {
     if (!statement)
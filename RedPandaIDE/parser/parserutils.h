@@ -16,7 +16,9 @@
  */
 #ifndef PARSER_UTILS_H
 #define PARSER_UTILS_H
+#include <QBitArray>
 #include <QMap>
+#include <QMutex>
 #include <QObject>
 #include <QSet>
 #include <QVector>
@@ -137,6 +139,52 @@ enum class EvalStatementKind {
     Function
 };
 
+/**
+ * @brief Dense integer ids of file names, shared by all parsers.
+ *
+ * Ids are never reused, so they can be saved in statements and include sets.
+ */
+class FileIdTable {
+public:
+    FileIdTable() = delete;
+    // get the id of the file, register it if needed. -1 for empty file name
+    static int idOf(const QString& fileName);
+    // -1 if the file is not registered
+    static int findId(const QString& fileName);
+    static QString fileName(int id);
+private:
+    static QMutex mMutex;
+    static QHash<QString,int> mIds;
+    static QStringList mFileNames;
+};
+
+/**
+ * @brief Set of file ids, saved as a bitset
+ */
+class FileIdSet {
+public:
+    void insert(int id) {
+        if (id<0)
+            return;
+        if (id>=mBits.size())
+            mBits.resize(qMax(id+1,mBits.size()*2));
+        mBits.setBit(id);
+    }
+    void unite(const FileIdSet& other) {
+        if (other.mBits.size()>mBits.size())
+            mBits.resize(other.mBits.size());
+        mBits |= other.mBits;
+    }
+    bool contains(int id) const {
+        return id>=0 && id<mBits.size() && mBits.testBit(id);
+    }
+    void clear() {
+        mBits.clear();
+    }
+private:
+    QBitArray mBits;
+};
+
 struct StatementMatchPosition{
     int start;
     int end;
@@ -153,7 +201,8 @@ enum StatementProperty {
     spOverride =            0x0040,
     spConstexpr =           0x0080,
     spFunctionPointer =     0x0100,
-    spOperatorOverloading = 0x0200
+    spOperatorOverloading = 0x0200,
+    spShared =              0x0400
 };
 
 Q_DECLARE_FLAGS(StatementProperties, StatementProperty)
@@ -162,13 +211,19 @@ Q_DECLARE_OPERATORS_FOR_FLAGS(StatementProperties)
 
 
 
-using PStatementMathPosition = std::shared_ptr<StatementMatchPosition>;
-
 struct Statement;
 using PStatement = std::shared_ptr<Statement>;
 using StatementList = QList<PStatement>;
 using PStatementList = std::shared_ptr<StatementList>;
 using StatementMap = QMultiMap<QString, PStatement>;
+
+// a base class of a class statement
+struct BaseClassInfo {
+    std::weak_ptr<Statement> statement;
+    QString fullName; // to find the base class again after it's reparsed
+    StatementAccessibility access; // public/protected/private inheritance
+};
+
 struct Statement {
 //    Statement();
 //    ~Statement();
@@ -184,7 +239,10 @@ struct Statement {
     int definitionLine; // definition
     QString fileName; // declaration
     QString definitionFileName; // definition
+    int fileId = -1; // id of fileName
+    int definitionFileId = -1; // id of definitionFileName
     StatementMap children; // functions can be overloaded,so we use list to save children with the same name
+    QList<BaseClassInfo> baseClasses; // base classes, their members are not copied into the class
     QSet<QString> friends; // friend class / functions
     QString fullName; // fullname(including class and namespace), ClassA::foo
     QSet<QString> usingList; // using namespaces
@@ -193,11 +251,6 @@ struct Statement {
 
     // fields for code completion
     int usageCount; //Usage Count
-    int matchPosTotal; // total of matched positions
-    int matchPosSpan; // distance between the first match pos and the last match pos;
-    int firstMatchLength; // length of first match;
-    int caseMatched; // if match with case
-    QList<PStatementMathPosition> matchPositions;
 
     // definiton line/filename is valid
     bool hasDefinition() {
@@ -229,6 +282,13 @@ struct Statement {
     bool isInherited() {
         return properties.testFlag(StatementProperty::spInherited);
     }; // inherted member;
+    // statement in a system header snapshot shared by parsers, shouldn't be modified
+    bool isShared() {
+        return properties.testFlag(StatementProperty::spShared);
+    }
+    void setIsShared(bool on) {
+        properties.setFlag(StatementProperty::spShared, on);
+    }
 
 };
 
@@ -262,6 +322,13 @@ public:
 };
 
 
+// members inherited by a class, built on demand by the parser
+struct InheritedMembers {
+    std::weak_ptr<Statement> classStatement; // the class may be freed and its address reused
+    StatementMap members;
+};
+using PInheritedMembers = std::shared_ptr<InheritedMembers>;
+
 struct UsingNamespace {
     QStringList namespaces; // List['std','foo'] for using namespace std::foo;
     QString filename;
@@ -284,13 +351,34 @@ public:
     PStatement lastScope();
     void removeLastScope();
     void clear();
+    const QVector<PCppScope>& scopes() const;
+    void setScopes(const QVector<PCppScope>& scopes);
 private:
     QVector<PCppScope> mScopes;
 };
 
+/**
+ * @brief Interns strings used by statements.
+ *
+ * Equal strings got from the pool share one copy of data (QString is implicitly shared),
+ * so duplicated types/names/file names are stored only once, and comparing them
+ * returns as soon as the data pointers are found equal.
+ */
+class StringPool {
+public:
+    QString intern(const QString& s);
+    // remove strings not used outside of the pool
+    void squeeze();
+    void clear();
+    int count() const;
+private:
+    QSet<QString> mStrings;
+};
+
 struct FileIncludes {
     QString baseFile;
     QMap<QString, bool> includeFiles; // true means the file is directly included, false means included indirectly
+    FileIdSet includeFileIds; // ids of includeFiles
     QStringList directIncludes; //
     QSet<QString> usings; // namespaces it usings
     StatementMap statements; // but we don't save temporary statements (full name as key)
@@ -299,6 +387,80 @@ struct FileIncludes {
 };
 using PFileIncludes = std::shared_ptr<FileIncludes>;
 
+struct FileParseStatistics {
+    QString fileName;
+    qint64 preprocessTime; // in nanoseconds
+    qint64 tokenizeTime; // in nanoseconds
+    qint64 parseTime; // in nanoseconds, building statements from tokens
+    int tokenCount;
+    int statementCount; // statements added when parsing the file
+};
+
+struct SemanticToken {
+    int column; // starts from 1, the same as QSynedit::BufferCoord::ch
+    int length;
+    StatementKind kind;
+};
+
+/**
+ * @brief Kinds of the identifiers in a file, built after the file is parsed
+ * so the editor can color them without looking up symbols while painting.
+ */
+struct FileSemanticTokens {
+    QStringList lines; // contents of the file the tokens are built from
+    QVector<QVector<SemanticToken>> tokens; // tokens of each line
+    // line starts from 1; false if the line is changed or the token is not in the table
+    bool kindAt(int line, int column, const QString& lineText, StatementKind& kind) const;
+};
+using PFileSemanticTokens = std::shared_ptr<const FileSemanticTokens>;
+
+struct SymbolReference {
+    int line; // starts from 1
+    int column; // starts from 1, the same as QSynedit::BufferCoord::ch
+    int length;
+};
+
+/**
+ * @brief Where the symbols are used in a file, recorded when the file is parsed
+ * so finding occurrences doesn't need to resolve every identifier of the project again.
+ */
+struct FileReferences {
+    QStringList lines; // contents of the file the references are recorded from
+    // key is the file and line of the referenced statement
+    QHash<QString,QVector<SymbolReference>> references;
+    // names of identifiers in expressions too complex to be resolved when recording
+    QSet<QString> unresolvedNames;
+    QVector<SymbolReference> referencesOf(const PStatement& statement) const;
+    static QString referenceKey(const PStatement& statement);
+    static QString referenceKey(const QString& fileName, int line);
+};
+using PFileReferences = std::shared_ptr<const FileReferences>;
+
+/**
+ * @brief Include relations of scanned files, in both directions.
+ *
+ * Like FileIncludes::includeFiles, the files included by a file contains
+ * the indirectly included ones.
+ * Relations of a file are kept after it's invalidated, until it's scanned again.
+ */
+class IncludeGraph {
+public:
+    // replace relations of the file
+    void setIncludes(const QString& fileName, const QList<QString>& includes);
+    bool contains(const QString& fileName) const;
+    QSet<QString> includes(const QString& fileName) const;
+    QSet<QString> includedBy(const QString& fileName) const;
+    void clear();
+    /**
+     * @brief sort files so that each file comes before the files it includes.
+     * Include cycles are broken at the file included by the fewest others.
+     */
+    QStringList sortByIncludeRelations(const QSet<QString>& files) const;
+private:
+    QHash<QString, QSet<QString>> mIncludes;
+    QHash<QString, QSet<QString>> mIncludedBy;
+};
+
 extern QStringList CppDirectives;
 extern QStringList JavadocTags;
 extern QMap<QString,KeywordType> CppKeywords;
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2020-2022 Roy Qu (royqh1979@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "parsescheduler.h"
+#include "cppparser.h"
+#include "../utils.h"
+
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QThread>
+#include <QTimer>
+
+Q_GLOBAL_STATIC(ParseScheduler, globalParseScheduler)
+
+// parsers are QObjects owned by the main thread, don't let a worker delete them
+static void releaseInMainThread(std::shared_ptr<CppParser> parser)
+{
+    QCoreApplication* app = QCoreApplication::instance();
+    if (!parser || !app || QThread::currentThread() == app->thread())
+        return;
+    QMetaObject::invokeMethod(app, [parser](){}, Qt::QueuedConnection);
+}
+
+class ParseRunnable : public QRunnable {
+public:
+    explicit ParseRunnable(ParseScheduler* scheduler, const PParseRequest& request):
+        mScheduler(scheduler),
+        mRequest(request) {
+        setAutoDelete(true);
+    }
+
+    void run() override {
+        bool done;
+        if (mRequest->isFileList)
+            done = mRequest->parser->parseFileList(mRequest->updateView);
+        else
+            done = mRequest->parser->parseFile(mRequest->fileName,
+                                               mRequest->inProject,
+                                               mRequest->onlyIfNotParsed,
+                                               mRequest->updateView);
+        mScheduler->finishRequest(mRequest, done);
+        mScheduler->releaseRequest(std::move(mRequest));
+    }
+private:
+    ParseScheduler* mScheduler;
+    PParseRequest mRequest;
+};
+
+ParseScheduler *ParseScheduler::instance()
+{
+    return globalParseScheduler;
+}
+
+ParseScheduler::ParseScheduler(QObject *parent):
+    QObject(parent),
+    mRunningCount(0),
+    mBackgroundRunningCount(0),
+    mNextSequence(0),
+    mRetryScheduled(false)
+{
+    // the retry timer needs an event loop, so always live in the main thread
+    if (QCoreApplication::instance())
+        moveToThread(QCoreApplication::instance()->thread());
+    mPool.setMaxThreadCount(qMax(2, QThread::idealThreadCount()/2));
+    // keep the workers alive, so reparsing doesn't pay for thread creation
+    mPool.setExpiryTimeout(-1);
+}
+
+ParseScheduler::~ParseScheduler()
+{
+    {
+        QMutexLocker locker(&mMutex);
+        mPendingRequests.clear();
+    }
+    mPool.waitForDone();
+}
+
+void ParseScheduler::scheduleFile(std::shared_ptr<CppParser> parser,
+                                  const QString &fileName,
+                                  bool inProject,
+                                  bool onlyIfNotParsed,
+                                  bool updateView,
+                                  ParsePriority priority)
+{
+    PParseRequest request = std::make_shared<ParseRequest>();
+    request->parser = parser;
+    request->fileName = fileName;
+    request->isFileList = false;
+    request->inProject = inProject;
+    request->onlyIfNotParsed = onlyIfNotParsed;
+    request->updateView = updateView;
+    request->priority = priority;
+    {
+        QMutexLocker locker(&mMutex);
+        enqueue(request, false);
+        // the running parse is outdated, stop it and let the new request do the job
+        PParseRequest running = mRunningRequests.value(parser.get());
+        if (running && !running->isFileList
+                && running->fileName == fileName
+                && running->inProject == inProject
+                && !onlyIfNotParsed)
+            parser->cancelParsing();
+    }
+    schedule();
+}
+
+void ParseScheduler::scheduleFileList(std::shared_ptr<CppParser> parser,
+                                      bool updateView,
+                                      ParsePriority priority)
+{
+    PParseRequest request = std::make_shared<ParseRequest>();
+    request->parser = parser;
+    request->isFileList = true;
+    request->inProject = true;
+    request->onlyIfNotParsed = false;
+    request->updateView = updateView;
+    request->priority = priority;
+    {
+        QMutexLocker locker(&mMutex);
+        enqueue(request, false);
+    }
+    schedule();
+}
+
+void ParseScheduler::cancelRequests(std::shared_ptr<CppParser> parser)
+{
+    if (!parser)
+        return;
+    QMutexLocker locker(&mMutex);
+    for (int i=mPendingRequests.count()-1;i>=0;i--) {
+        if (mPendingRequests[i]->parser == parser)
+            mPendingRequests.removeAt(i);
+    }
+    if (mRunningRequests.contains(parser.get()))
+        parser->cancelParsing();
+}
+
+void ParseScheduler::schedule()
+{
+    QList<std::shared_ptr<CppParser>> unusedParsers;
+    auto action = finally([&unusedParsers]{
+        foreach (const std::shared_ptr<CppParser>& parser, unusedParsers)
+            releaseInMainThread(parser);
+    });
+    QMutexLocker locker(&mMutex);
+    dropUnusedRequests(unusedParsers);
+    while (true) {
+        PParseRequest request = takeNextRequest();
+        if (!request)
+            break;
+        mRunningRequests.insert(request->parser.get(),request);
+        mRunningCount++;
+        if (request->priority == ParsePriority::Background)
+            mBackgroundRunningCount++;
+        mPool.start(new ParseRunnable(this, request));
+    }
+}
+
+void ParseScheduler::retryLater()
+{
+    QTimer::singleShot(PARSE_RETRY_DELAY, this, [this](){
+        {
+            QMutexLocker locker(&mMutex);
+            mRetryScheduled = false;
+            mBusyParsers.clear();
+        }
+        schedule();
+    });
+}
+
+void ParseScheduler::enqueue(const PParseRequest &request, bool requeued)
+{
+    foreach (const PParseRequest& pending, mPendingRequests) {
+        if (pending->parser != request->parser
+                || pending->isFileList != request->isFileList
+                || pending->fileName != request->fileName)
+            continue;
+        // merge into the pending request, keeping its place in the queue
+        pending->priority = qMax(pending->priority, request->priority);
+        if (!requeued)
+            pending->inProject = request->inProject;
+        pending->sequence = qMin(pending->sequence, request->sequence);
+        pending->onlyIfNotParsed = pending->onlyIfNotParsed && request->onlyIfNotParsed;
+        pending->updateView = pending->updateView || request->updateView;
+        return;
+    }
+    if (!requeued)
+        request->sequence = mNextSequence++;
+    mPendingRequests.append(request);
+}
+
+void ParseScheduler::dropUnusedRequests(QList<std::shared_ptr<CppParser> > &unusedParsers)
+{
+    // references to the parsers held by the requests
+    QHash<CppParser*,long> requestRefs;
+    foreach (const PParseRequest& request, mPendingRequests)
+        requestRefs[request->parser.get()]++;
+    foreach (const PParseRequest& request, mRunningRequests)
+        requestRefs[request->parser.get()]++;
+    for (int i=mPendingRequests.count()-1;i>=0;i--) {
+        const std::shared_ptr<CppParser>& parser = mPendingRequests[i]->parser;
+        // its editor or project is closed
+        if (parser.use_count() <= requestRefs.value(parser.get())) {
+            unusedParsers.append(parser);
+            mPendingRequests.removeAt(i);
+        }
+    }
+}
+
+void ParseScheduler::releaseRequest(PParseRequest request)
+{
+    if (!QCoreApplication::instance())
+        return;
+    // the editor may drop the parser while it's parsing, so the request may hold
+    // the last reference to it
+    QMetaObject::invokeMethod(this, [this,request]() mutable {
+        request.reset();
+        schedule();
+    }, Qt::QueuedConnection);
+}
+
+PParseRequest ParseScheduler::takeNextRequest()
+{
+    int maxCount = mPool.maxThreadCount();
+    if (mRunningCount >= maxCount)
+        return PParseRequest();
+    // always leave a worker for the file being edited
+    bool backgroundAllowed = (mBackgroundRunningCount < maxCount - 1);
+    int best = -1;
+    for (int i=0;i<mPendingRequests.count();i++) {
+        const PParseRequest& request = mPendingRequests[i];
+        if (mRunningRequests.contains(request->parser.get())
+                || mBusyParsers.contains(request->parser.get()))
+            continue;
+        if (request->priority == ParsePriority::Background && !backgroundAllowed)
+            continue;
+        if (best<0) {
+            best = i;
+            continue;
+        }
+        const PParseRequest& bestRequest = mPendingRequests[best];
+        if (request->priority > bestRequest->priority
+                || (request->priority == bestRequest->priority
+                    && request->sequence < bestRequest->sequence))
+            best = i;
+    }
+    if (best<0)
+        return PParseRequest();
+    return mPendingRequests.takeAt(best);
+}
+
+void ParseScheduler::finishRequest(const PParseRequest &request, bool done)
+{
+    bool needRetry = false;
+    {
+        QMutexLocker locker(&mMutex);
+        mRunningRequests.remove(request->parser.get());
+        mRunningCount--;
+        if (request->priority == ParsePriority::Background)
+            mBackgroundRunningCount--;
+        if (!done) {
+            // the parser is busy, try it again later
+            mBusyParsers.insert(request->parser.get());
+            enqueue(request, true);
+            if (!mRetryScheduled) {
+                mRetryScheduled = true;
+                needRetry = true;
+            }
+        }
+    }
+    if (needRetry)
+        QMetaObject::invokeMethod(this, "retryLater", Qt::QueuedConnection);
+    schedule();
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2020-2022 Roy Qu (royqh1979@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef PARSESCHEDULER_H
+#define PARSESCHEDULER_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+#include <memory>
+
+#define PARSE_RETRY_DELAY 100
+
+class CppParser;
+
+enum class ParsePriority {
+    Background, // project files parsed in the background
+    Normal,
+    Active // the file in the current editor
+};
+
+struct ParseRequest {
+    std::shared_ptr<CppParser> parser;
+    QString fileName; // empty for a file list request
+    bool isFileList;
+    bool inProject;
+    bool onlyIfNotParsed;
+    bool updateView;
+    ParsePriority priority;
+    quint64 sequence;
+};
+
+using PParseRequest = std::shared_ptr<ParseRequest>;
+
+/**
+ * Queues parse requests and runs them on a fixed pool of worker threads.
+ *
+ * Pending requests for the same file of the same parser are merged into one.
+ * A parser runs at most one request at a time; requests it can't take because
+ * it's busy are put back and retried later instead of being dropped.
+ * A running parse of a file is cancelled when the file is scheduled again.
+ */
+class ParseScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    static ParseScheduler* instance();
+
+    void scheduleFile(std::shared_ptr<CppParser> parser,
+                      const QString& fileName,
+                      bool inProject,
+                      bool onlyIfNotParsed,
+                      bool updateView,
+                      ParsePriority priority);
+    void scheduleFileList(std::shared_ptr<CppParser> parser,
+                          bool updateView,
+                          ParsePriority priority);
+    // drop pending requests of the parser and cancel its running parse
+    void cancelRequests(std::shared_ptr<CppParser> parser);
+
+    explicit ParseScheduler(QObject *parent = nullptr);
+    ~ParseScheduler();
+private slots:
+    void schedule();
+    void retryLater();
+private:
+    // must be called with mMutex locked
+    void enqueue(const PParseRequest& request, bool requeued);
+    // must be called with mMutex locked
+    void dropUnusedRequests(QList<std::shared_ptr<CppParser>>& unusedParsers);
+    // must be called with mMutex locked
+    PParseRequest takeNextRequest();
+    void finishRequest(const PParseRequest& request, bool done);
+    // drop the request in the main thread
+    void releaseRequest(PParseRequest request);
+    friend class ParseRunnable;
+private:
+    QMutex mMutex;
+    QThreadPool mPool;
+    QList<PParseRequest> mPendingRequests;
+    QHash<CppParser*,PParseRequest> mRunningRequests;
+    QSet<CppParser*> mBusyParsers;
+    int mRunningCount;
+    int mBackgroundRunningCount;
+    quint64 mNextSequence;
+    bool mRetryScheduled;
+};
+
+#endif // PARSESCHEDULER_H
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2020-2022 Roy Qu (royqh1979@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "preprocessedheadercache.h"
+
+#include <QCryptographicHash>
+
+QMutex PreprocessedHeaderCache::mMutex;
+QCache<QString, PPreprocessedHeader> PreprocessedHeaderCache::mHeaders(MAX_PREPROCESSED_HEADER_CACHE_LINES);
+
+QByteArray PreprocessedHeaderCache::contentHash(const QStringList &lines)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    foreach (const QString& line, lines) {
+        hash.addData((const char*)line.constData(), line.length()*sizeof(QChar));
+        hash.addData("\n",1);
+    }
+    return hash.result();
+}
+
+PPreprocessedHeader PreprocessedHeaderCache::find(const QString &fileName, const QByteArray &contentHash)
+{
+    QMutexLocker locker(&mMutex);
+    PPreprocessedHeader* header = mHeaders.object(fileName);
+    if (!header || (*header)->contentHash!=contentHash)
+        return PPreprocessedHeader();
+    return *header;
+}
+
+void PreprocessedHeaderCache::insert(const PPreprocessedHeader &header)
+{
+    QMutexLocker locker(&mMutex);
+    //entries bigger than the cache are dropped by QCache
+    mHeaders.insert(header->fileName,
+                    new PPreprocessedHeader(header),
+                    qMax(1,header->result.count()));
+}
+
+void PreprocessedHeaderCache::clear()
+{
+    QMutexLocker locker(&mMutex);
+    mHeaders.clear();
+}
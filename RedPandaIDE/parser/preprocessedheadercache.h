@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2020-2022 Roy Qu (royqh1979@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef PREPROCESSEDHEADERCACHE_H
+#define PREPROCESSEDHEADERCACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include "parserutils.h"
+
+#define MAX_PREPROCESSED_HEADER_CACHE_LINES 500000
+
+enum class PreprocessEventType {
+    Lookup, // a macro is looked up
+    Define, // a macro is defined
+    Undefine, // a macro is undefined
+    Include // an #include directive is handled
+};
+
+enum class IncludeOutcome {
+    Unresolved, // the header file is not found
+    Skipped, // already included by the file being preprocessed
+    Scanned, // scanned before, only its defines are used
+    Opened // scanned for the first time
+};
+
+/**
+ * @brief Everything the preprocessing of a header depends on from outside, in order.
+ */
+struct PreprocessEvent {
+    PreprocessEventType type;
+    QString name; // name of the macro, or the header file of an #include
+    PDefine define; // Lookup: the define found (nullptr if not defined); Define: the new define
+    QString includer; // Include: file that contains the directive
+    QString directive; // Include: the directive line
+    bool fromNext; // Include: it's an #include_next
+    IncludeOutcome outcome; // Include
+    QByteArray contentHash; // Include: content hash of an opened header (empty if not loaded)
+};
+
+/**
+ * @brief Include records and defines left by a preprocessed file
+ */
+struct PreprocessedFileRecord {
+    QString fileName;
+    QMap<QString, bool> includeFiles;
+    FileIdSet includeFileIds;
+    QStringList directIncludes;
+    PDefineMap defines; // nullptr if the file doesn't define anything
+};
+
+/**
+ * @brief The result of preprocessing a header (and all headers first opened by it).
+ *
+ * It can be reused when the header is unchanged and replaying its events
+ * in the current preprocessing state gives the same results.
+ * Results may be shared by many preprocessors, so everything in it is read-only.
+ */
+struct PreprocessedHeader {
+    QString fileName;
+    QByteArray contentHash;
+    QList<PreprocessEvent> events;
+    QStringList result; // lines added to the preprocess result
+    QList<PreprocessedFileRecord> files; // the header itself, then headers opened by it
+};
+using PPreprocessedHeader = std::shared_ptr<PreprocessedHeader>;
+
+/**
+ * @brief Process-wide cache of preprocessed headers, shared by all preprocessors
+ */
+class PreprocessedHeaderCache
+{
+public:
+    PreprocessedHeaderCache() = delete;
+    static QByteArray contentHash(const QStringList& lines);
+    /**
+     * @brief find the cached result of the header
+     * @return nullptr if not cached, or cached for different contents
+     */
+    static PPreprocessedHeader find(const QString& fileName, const QByteArray& contentHash);
+    static void insert(const PPreprocessedHeader& header);
+    static void clear();
+private:
+    static QMutex mMutex;
+    static QCache<QString, PPreprocessedHeader> mHeaders; // cost is the count of result lines
+};
+
+#endif // PREPROCESSEDHEADERCACHE_H
@@ -31,7 +31,10 @@ void StatementModel::add(const PStatement& statement)
     }
     PStatement parent = statement->parentScope.lock();
     if (parent) {
-        addMember(parent->children,statement);
+        if (parent->isShared())
+            addMember(childrenOfShared(parent),statement);
+        else
+            addMember(parent->children,statement);
     } else {
         addMember(mGlobalStatements,statement);
     }
@@ -50,7 +53,13 @@ void StatementModel::deleteStatement(const PStatement& statement)
     PStatement parent = statement->parentScope.lock();
     int count = 0;
     if (parent) {
-        count = deleteMember(parent->children,statement);
+        if (parent->isShared()) {
+            //statements of the snapshot are not deleted
+            if (statement->isShared())
+                return;
+            count = deleteMember(childrenOfShared(parent),statement);
+        } else
+            count = deleteMember(parent->children,statement);
     } else {
         count = deleteMember(mGlobalStatements,statement);
     }
@@ -61,13 +70,42 @@ void StatementModel::deleteStatement(const PStatement& statement)
 
 }
 
+void StatementModel::deleteStatementTree(const PStatement &statement)
+{
+    if (!statement) {
+        return ;
+    }
+    PStatement parent = statement->parentScope.lock();
+    int count = 0;
+    if (parent) {
+        if (parent->isShared()) {
+            if (statement->isShared())
+                return;
+            count = deleteMember(childrenOfShared(parent),statement);
+        } else
+            count = deleteMember(parent->children,statement);
+    } else {
+        count = deleteMember(mGlobalStatements,statement);
+    }
+    //descendants are only counted if the statement was still in the tree
+    if (count>0)
+        count += deleteDescendants(statement);
+    mCount -= count;
+#ifdef QT_DEBUG
+    mAllStatements.removeOne(statement);
+#endif
+}
+
 const StatementMap &StatementModel::childrenStatements(const PStatement& statement) const
 {
     if (!statement) {
         return mGlobalStatements;
-    } else {
-        return statement->children;
+    } else if (statement->isShared()) {
+        auto it = mChildrenOfShared.constFind(statement.get());
+        if (it!=mChildrenOfShared.constEnd())
+            return *(it.value());
     }
+    return statement->children;
 }
 
 const StatementMap &StatementModel::childrenStatements(std::weak_ptr<Statement> statement) const
@@ -79,11 +117,17 @@ const StatementMap &StatementModel::childrenStatements(std::weak_ptr<Statement>
 void StatementModel::clear() {
     mCount=0;
     mGlobalStatements.clear();
+    mChildrenOfShared.clear();
 #ifdef QT_DEBUG
     mAllStatements.clear();
 #endif
 }
 
+int StatementModel::count() const
+{
+    return mCount;
+}
+
 #ifdef QT_DEBUG
 void StatementModel::dump(const QString &logFile)
 {
@@ -139,6 +183,64 @@ int StatementModel::deleteMember(StatementMap &map, const PStatement& statement)
     return map.remove(statement->command,statement);
 }
 
+int StatementModel::deleteDescendants(const PStatement &statement)
+{
+    int count = 0;
+    if (statement->isShared()) {
+        std::shared_ptr<StatementMap> children = mChildrenOfShared.take(statement.get());
+        if (children) {
+            foreach (const PStatement& child, *children) {
+                //shared children are not deleted, but they may have children of this model too
+                if (child->isShared()) {
+                    count += deleteDescendants(child);
+                    continue;
+                }
+                count += 1 + deleteDescendants(child);
+#ifdef QT_DEBUG
+                mAllStatements.removeOne(child);
+#endif
+            }
+        }
+        return count;
+    }
+    foreach (const PStatement& child, statement->children) {
+        count += 1 + deleteDescendants(child);
+#ifdef QT_DEBUG
+        mAllStatements.removeOne(child);
+#endif
+    }
+    //so children from other files are not counted again when their files are invalidated
+    statement->children.clear();
+    return count;
+}
+
+void StatementModel::shareStatement(const PStatement &statement, const QSet<QString> &sharedFiles)
+{
+    if (!statement || statement->isShared())
+        return;
+    StatementMap ownChildren;
+    for (auto it=statement->children.constBegin();it!=statement->children.constEnd();++it) {
+        if (!sharedFiles.contains(it.value()->fileName))
+            ownChildren.insert(it.key(),it.value());
+    }
+    if (!ownChildren.isEmpty()) {
+        mChildrenOfShared.insert(statement.get(),std::make_shared<StatementMap>(statement->children));
+        for (auto it=ownChildren.constBegin();it!=ownChildren.constEnd();++it)
+            statement->children.remove(it.key(),it.value());
+    }
+    statement->setIsShared(true);
+}
+
+StatementMap &StatementModel::childrenOfShared(const PStatement &statement)
+{
+    std::shared_ptr<StatementMap>& children = mChildrenOfShared[statement.get()];
+    if (!children) {
+        //the shared children are not changed while the snapshot is used
+        children = std::make_shared<StatementMap>(statement->children);
+    }
+    return *children;
+}
+
 void StatementModel::dumpStatementMap(StatementMap &map, QTextStream &out, int level)
 {
     QString indent(level,'\t');
@@ -33,9 +33,17 @@ public:
 //    function DeleteFirst: Integer;
 //    function DeleteLast: Integer;
     void deleteStatement(const PStatement& statement);
+    // delete the statement together with all its descendants
+    void deleteStatementTree(const PStatement& statement);
+    /**
+     * @brief mark the statement as shared with other parsers (see Statement::isShared()).
+     * Its children not from the shared files are kept by this model instead.
+     */
+    void shareStatement(const PStatement& statement, const QSet<QString>& sharedFiles);
     const StatementMap& childrenStatements(const PStatement& statement = PStatement()) const;
     const StatementMap& childrenStatements(std::weak_ptr<Statement> statement) const;
     void clear();
+    int count() const;
 #ifdef QT_DEBUG
     void dump(const QString& logFile);
     void dumpAll(const QString& logFile);
@@ -43,10 +51,16 @@ public:
 private:
     void addMember(StatementMap& map, const PStatement& statement);
     int deleteMember(StatementMap& map, const PStatement& statement);
+    int deleteDescendants(const PStatement& statement);
+    // children of the shared statement in this model, created when needed
+    StatementMap& childrenOfShared(const PStatement& statement);
     void dumpStatementMap(StatementMap& map, QTextStream& out, int level);
 private:
     int mCount;
     StatementMap mGlobalStatements;  //may have overloaded functions, so use PStatementList to store
+    // Shared statements can't be changed, so children added to them by this model are kept here,
+    // together with their own children. Key is the shared statement.
+    QHash<const Statement*, std::shared_ptr<StatementMap>> mChildrenOfShared;
 #ifdef QT_DEBUG
     StatementList mAllStatements;
 #endif
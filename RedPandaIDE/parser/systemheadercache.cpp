@@ -0,0 +1,459 @@
+/*
+ * Copyright (C) 2020-2022 Roy Qu (royqh1979@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "systemheadercache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include "../utils.h"
+
+#define SYSTEM_HEADER_CACHE_MAGIC 0x52504843 // "RPHC"
+
+namespace {
+//All strings are saved once in a table, and referred by its index
+class StringTable {
+public:
+    qint32 indexOf(const QString& s) {
+        auto it = mIndexes.constFind(s);
+        if (it != mIndexes.constEnd())
+            return it.value();
+        qint32 index = mStrings.count();
+        mStrings.append(s);
+        mIndexes.insert(s,index);
+        return index;
+    }
+    const QStringList& strings() const {
+        return mStrings;
+    }
+private:
+    QStringList mStrings;
+    QHash<QString,qint32> mIndexes;
+};
+
+void writeStrings(QDataStream& out, StringTable& table, const QSet<QString>& strings) {
+    out<<(qint32)strings.count();
+    foreach (const QString& s, strings)
+        out<<table.indexOf(s);
+}
+
+void writeStrings(QDataStream& out, StringTable& table, const QStringList& strings) {
+    out<<(qint32)strings.count();
+    foreach (const QString& s, strings)
+        out<<table.indexOf(s);
+}
+
+QString readString(QDataStream& in, const QStringList& strings) {
+    qint32 index;
+    in>>index;
+    return strings.value(index);
+}
+
+QStringList readStringList(QDataStream& in, const QStringList& strings) {
+    qint32 count;
+    in>>count;
+    QStringList result;
+    for (int i=0;i<count && in.status()==QDataStream::Ok;i++)
+        result.append(readString(in,strings));
+    return result;
+}
+
+void writeStatement(QDataStream& out, StringTable& table,
+                    const PStatement& statement, qint32 parentIndex,
+                    const QHash<QString, qint64>& headers,
+                    const QHash<const Statement*, qint32>& statementIndexes) {
+    StatementProperties properties = statement->properties;
+    QString definitionFileName = statement->definitionFileName;
+    int definitionLine = statement->definitionLine;
+    //definitions outside of the system headers are not cached
+    if (!headers.contains(definitionFileName)) {
+        properties.setFlag(StatementProperty::spHasDefinition,false);
+        definitionFileName = statement->fileName;
+        definitionLine = statement->line;
+    }
+    out<<parentIndex
+       <<table.indexOf(statement->type)
+       <<table.indexOf(statement->command)
+       <<table.indexOf(statement->args)
+       <<table.indexOf(statement->noNameArgs)
+       <<table.indexOf(statement->value)
+       <<table.indexOf(statement->fullName)
+       <<table.indexOf(statement->fileName)
+       <<table.indexOf(definitionFileName)
+       <<(qint32)statement->kind
+       <<(qint32)statement->scope
+       <<(qint32)statement->accessibility
+       <<(qint32)statement->line
+       <<(qint32)definitionLine
+       <<(quint32)properties;
+    writeStrings(out,table,statement->friends);
+    writeStrings(out,table,statement->usingList);
+    out<<(qint32)statement->baseClasses.count();
+    foreach (const BaseClassInfo& baseClass, statement->baseClasses) {
+        PStatement base = baseClass.statement.lock();
+        out<<statementIndexes.value(base.get(),-1)
+           <<table.indexOf(baseClass.fullName)
+           <<(qint32)baseClass.access;
+    }
+}
+
+PStatement readStatement(QDataStream& in, const QStringList& strings,
+                         const StatementList& statements) {
+    PStatement statement = std::make_shared<Statement>();
+    qint32 parentIndex,kind,scope,accessibility,line,definitionLine;
+    quint32 properties;
+    in>>parentIndex;
+    if (parentIndex>=statements.count())
+        return PStatement();
+    PStatement parent;
+    if (parentIndex>=0)
+        parent = statements[parentIndex];
+    statement->parentScope = parent;
+    statement->type = readString(in,strings);
+    statement->command = readString(in,strings);
+    statement->args = readString(in,strings);
+    statement->noNameArgs = readString(in,strings);
+    statement->value = readString(in,strings);
+    statement->fullName = readString(in,strings);
+    statement->fileName = readString(in,strings);
+    statement->definitionFileName = readString(in,strings);
+    statement->fileId = FileIdTable::idOf(statement->fileName);
+    statement->definitionFileId = FileIdTable::idOf(statement->definitionFileName);
+    in>>kind>>scope>>accessibility>>line>>definitionLine>>properties;
+    statement->kind = (StatementKind)kind;
+    statement->scope = (StatementScope)scope;
+    statement->accessibility = (StatementAccessibility)accessibility;
+    statement->line = line;
+    statement->definitionLine = definitionLine;
+    statement->properties = StatementProperties(QFlag((int)properties));
+    statement->setIsShared(true);
+    foreach (const QString& s, readStringList(in,strings))
+        statement->friends.insert(s);
+    foreach (const QString& s, readStringList(in,strings))
+        statement->usingList.insert(s);
+    qint32 baseCount;
+    in>>baseCount;
+    for (int i=0;i<baseCount && in.status()==QDataStream::Ok;i++) {
+        qint32 baseIndex,access;
+        BaseClassInfo baseClass;
+        in>>baseIndex;
+        //bases outside of the snapshot are found by name when needed
+        if (baseIndex>=0 && baseIndex<statements.count())
+            baseClass.statement = statements[baseIndex];
+        baseClass.fullName = readString(in,strings);
+        in>>access;
+        baseClass.access = (StatementAccessibility)access;
+        statement->baseClasses.append(baseClass);
+    }
+    statement->usageCount = -1;
+    //statements in the snapshot are linked here, so parsers using it only need to add the root ones
+    if (parent)
+        parent->children.insert(statement->command,statement);
+    return statement;
+}
+
+void writeFileIncludes(QDataStream& out, StringTable& table,
+                       const PFileIncludes& fileIncludes,
+                       const QHash<const Statement*, qint32>& statementIndexes) {
+    out<<table.indexOf(fileIncludes->baseFile);
+    out<<(qint32)fileIncludes->includeFiles.count();
+    for (auto it=fileIncludes->includeFiles.constBegin();
+         it!=fileIncludes->includeFiles.constEnd();++it) {
+        out<<table.indexOf(it.key())<<it.value();
+    }
+    writeStrings(out,table,fileIncludes->directIncludes);
+    writeStrings(out,table,fileIncludes->usings);
+    QList<QPair<QString,qint32>> statements;
+    for (auto it=fileIncludes->statements.constBegin();
+         it!=fileIncludes->statements.constEnd();++it) {
+        qint32 index = statementIndexes.value(it.value().get(),-1);
+        if (index>=0)
+            statements.append(QPair<QString,qint32>(it.key(),index));
+    }
+    out<<(qint32)statements.count();
+    foreach (const auto& pair, statements) {
+        out<<table.indexOf(pair.first)<<pair.second;
+    }
+    const QVector<PCppScope>& scopes = fileIncludes->scopes.scopes();
+    out<<(qint32)scopes.count();
+    foreach (const PCppScope& scope, scopes) {
+        out<<(qint32)scope->startLine
+           <<statementIndexes.value(scope->statement.get(),-1);
+    }
+}
+
+PFileIncludes readFileIncludes(QDataStream& in, const QStringList& strings,
+                               const StatementList& statements) {
+    PFileIncludes fileIncludes = std::make_shared<FileIncludes>();
+    fileIncludes->baseFile = readString(in,strings);
+    qint32 count;
+    in>>count;
+    for (int i=0;i<count && in.status()==QDataStream::Ok;i++) {
+        QString file = readString(in,strings);
+        bool direct;
+        in>>direct;
+        fileIncludes->includeFiles.insert(file,direct);
+        fileIncludes->includeFileIds.insert(FileIdTable::idOf(file));
+    }
+    fileIncludes->directIncludes = readStringList(in,strings);
+    foreach (const QString& s, readStringList(in,strings))
+        fileIncludes->usings.insert(s);
+    in>>count;
+    for (int i=0;i<count && in.status()==QDataStream::Ok;i++) {
+        QString key = readString(in,strings);
+        qint32 index;
+        in>>index;
+        if (index<0 || index>=statements.count())
+            return PFileIncludes();
+        fileIncludes->statements.insert(key,statements[index]);
+    }
+    in>>count;
+    for (int i=0;i<count && in.status()==QDataStream::Ok;i++) {
+        qint32 line,index;
+        in>>line>>index;
+        if (index>=statements.count())
+            return PFileIncludes();
+        fileIncludes->scopes.addScope(line, index>=0?statements[index]:PStatement());
+    }
+    return fileIncludes;
+}
+
+void writeDefine(QDataStream& out, StringTable& table, const PDefine& define) {
+    out<<table.indexOf(define->name)
+       <<table.indexOf(define->args)
+       <<table.indexOf(define->value)
+       <<table.indexOf(define->filename)
+       <<define->hardCoded;
+    writeStrings(out,table,define->argList);
+    out<<define->argUsed
+       <<table.indexOf(define->formatValue);
+}
+
+PDefine readDefine(QDataStream& in, const QStringList& strings) {
+    PDefine define = std::make_shared<Define>();
+    define->name = readString(in,strings);
+    define->args = readString(in,strings);
+    define->value = readString(in,strings);
+    define->filename = readString(in,strings);
+    in>>define->hardCoded;
+    define->argList = readStringList(in,strings);
+    in>>define->argUsed;
+    define->formatValue = readString(in,strings);
+    return define;
+}
+
+}
+
+QMutex SystemHeaderCache::mSharedSymbolsMutex;
+QHash<QString, std::weak_ptr<SystemHeaderSymbols>> SystemHeaderCache::mSharedSymbols;
+
+QString SystemHeaderCache::calcKey(const QString &compilerSetId,
+                                   ParserLanguage language,
+                                   const QList<QString> &includePaths,
+                                   const DefineMap &hardDefines)
+{
+    QStringList lines;
+    lines.append(compilerSetId);
+    lines.append(QString::number((int)language));
+    lines.append(includePaths);
+    QStringList defineNames = hardDefines.keys();
+    defineNames.sort();
+    foreach (const QString& name, defineNames) {
+        PDefine define = hardDefines.value(name);
+        lines.append(QString("#define %1%2 %3").arg(define->name,define->args,define->value));
+    }
+    return lines.join('\n');
+}
+
+QString SystemHeaderCache::cacheFileName(const QString &cacheFolder, const QString &key)
+{
+    QByteArray hash = QCryptographicHash::hash(key.toUtf8(),QCryptographicHash::Sha1).toHex();
+    return includeTrailingPathDelimiter(cacheFolder) + QString::fromLatin1(hash) + ".cache";
+}
+
+bool SystemHeaderCache::save(const QString &fileName, const PSystemHeaderSymbols &symbols)
+{
+    if (!symbols)
+        return false;
+    QDir dir(extractFileDir(fileName));
+    if (!dir.exists() && !dir.mkpath(dir.absolutePath()))
+        return false;
+
+    StringTable table;
+    QByteArray body;
+    {
+        QDataStream out(&body, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_6);
+
+        out<<(qint32)symbols->timestamps.count();
+        for (auto it=symbols->timestamps.constBegin();
+             it!=symbols->timestamps.constEnd();++it) {
+            out<<table.indexOf(it.key())<<it.value();
+        }
+
+        QHash<const Statement*, qint32> statementIndexes;
+        out<<(qint32)symbols->statements.count();
+        foreach (const PStatement& statement, symbols->statements) {
+            PStatement parent = statement->parentScope.lock();
+            writeStatement(out,table,statement,
+                           statementIndexes.value(parent.get(),-1),
+                           symbols->timestamps,
+                           statementIndexes);
+            statementIndexes.insert(statement.get(),statementIndexes.count());
+        }
+
+        out<<(qint32)symbols->includes.count();
+        foreach (const PFileIncludes& fileIncludes, symbols->includes) {
+            writeFileIncludes(out,table,fileIncludes,statementIndexes);
+        }
+
+        out<<(qint32)symbols->defines.count();
+        for (auto it=symbols->defines.constBegin();
+             it!=symbols->defines.constEnd();++it) {
+            out<<table.indexOf(it.key());
+            out<<(qint32)it.value()->count();
+            foreach (const PDefine& define, *(it.value())) {
+                writeDefine(out,table,define);
+            }
+        }
+        writeStrings(out,table,symbols->inlineNamespaces);
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate))
+        return false;
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+    out<<(quint32)SYSTEM_HEADER_CACHE_MAGIC
+       <<(quint32)SYSTEM_HEADER_CACHE_VERSION
+       <<symbols->key
+       <<table.strings();
+    out.writeRawData(body.constData(),body.size());
+    if (out.status()!=QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+PSystemHeaderSymbols SystemHeaderCache::load(const QString &fileName, const QString &key)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return PSystemHeaderSymbols();
+    QByteArray buffer;
+    uchar* data = file.map(0,file.size());
+    if (data)
+        buffer = QByteArray::fromRawData((const char*)data,file.size());
+    else
+        buffer = file.readAll();
+    auto action = finally([&file,data]{
+        if (data)
+            file.unmap(data);
+    });
+
+    QDataStream in(buffer);
+    in.setVersion(QDataStream::Qt_5_6);
+    quint32 magic,version;
+    QString cachedKey;
+    in>>magic>>version;
+    if (magic!=SYSTEM_HEADER_CACHE_MAGIC || version!=SYSTEM_HEADER_CACHE_VERSION)
+        return PSystemHeaderSymbols();
+    in>>cachedKey;
+    if (cachedKey!=key)
+        return PSystemHeaderSymbols();
+
+    PSystemHeaderSymbols symbols = std::make_shared<SystemHeaderSymbols>();
+    symbols->key = key;
+    QStringList strings;
+    in>>strings;
+
+    qint32 count;
+    in>>count;
+    for (int i=0;i<count && in.status()==QDataStream::Ok;i++) {
+        QString header = readString(in,strings);
+        qint64 timestamp;
+        in>>timestamp;
+        //a header is changed after the cache is saved
+        if (fileTimestamp(header)!=timestamp)
+            return PSystemHeaderSymbols();
+        symbols->timestamps.insert(header,timestamp);
+    }
+
+    in>>count;
+    for (int i=0;i<count && in.status()==QDataStream::Ok;i++) {
+        PStatement statement = readStatement(in,strings,symbols->statements);
+        if (!statement)
+            return PSystemHeaderSymbols();
+        symbols->statements.append(statement);
+    }
+
+    in>>count;
+    for (int i=0;i<count && in.status()==QDataStream::Ok;i++) {
+        PFileIncludes fileIncludes = readFileIncludes(in,strings,symbols->statements);
+        if (!fileIncludes)
+            return PSystemHeaderSymbols();
+        symbols->includes.insert(fileIncludes->baseFile,fileIncludes);
+    }
+
+    in>>count;
+    for (int i=0;i<count && in.status()==QDataStream::Ok;i++) {
+        QString header = readString(in,strings);
+        qint32 defineCount;
+        in>>defineCount;
+        PDefineMap defineMap = std::make_shared<DefineMap>();
+        for (int j=0;j<defineCount && in.status()==QDataStream::Ok;j++) {
+            PDefine define = readDefine(in,strings);
+            defineMap->insert(define->name,define);
+        }
+        symbols->defines.insert(header,defineMap);
+    }
+    foreach (const QString& s, readStringList(in,strings))
+        symbols->inlineNamespaces.insert(s);
+
+    if (in.status()!=QDataStream::Ok)
+        return PSystemHeaderSymbols();
+    return symbols;
+}
+
+qint64 SystemHeaderCache::fileTimestamp(const QString &fileName)
+{
+    QFileInfo info(fileName);
+    if (!info.exists())
+        return -1;
+    return info.lastModified().toMSecsSinceEpoch();
+}
+
+PSystemHeaderSymbols SystemHeaderCache::sharedSymbols(const QString &key)
+{
+    QMutexLocker locker(&mSharedSymbolsMutex);
+    PSystemHeaderSymbols symbols = mSharedSymbols.value(key).lock();
+    if (!symbols)
+        mSharedSymbols.remove(key);
+    return symbols;
+}
+
+void SystemHeaderCache::shareSymbols(const PSystemHeaderSymbols &symbols)
+{
+    if (!symbols)
+        return;
+    QMutexLocker locker(&mSharedSymbolsMutex);
+    mSharedSymbols.insert(symbols->key,symbols);
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2020-2022 Roy Qu (royqh1979@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SYSTEMHEADERCACHE_H
+#define SYSTEMHEADERCACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include "parserutils.h"
+
+#define SYSTEM_HEADER_CACHE_VERSION 2
+
+/**
+ * @brief Symbols, include records and defines produced by parsing system headers.
+ *
+ * Statements are ordered so that the parent scope of a statement
+ * is always placed before the statement itself.
+ * A snapshot may be shared by many parsers, so everything in it
+ * (including the statements, which are marked with spShared) is read-only.
+ */
+struct SystemHeaderSymbols {
+    QString key;
+    StatementList statements;
+    QHash<QString, PFileIncludes> includes; // include records of each header
+    QHash<QString, PDefineMap> defines; // defines of each header
+    QHash<QString, qint64> timestamps; // last modified time of each header
+    QSet<QString> inlineNamespaces;
+};
+using PSystemHeaderSymbols = std::shared_ptr<SystemHeaderSymbols>;
+
+/**
+ * @brief Versioned binary on-disk cache of SystemHeaderSymbols,
+ * and the in-memory registry of snapshots shared between parsers
+ */
+class SystemHeaderCache
+{
+public:
+    SystemHeaderCache() = delete;
+
+    /**
+     * @brief calculate the key that identifies a parsing environment
+     * @param compilerSetId the compiler set used to get include dirs and defines
+     * @param language
+     * @param includePaths system include paths, in order
+     * @param hardDefines
+     * @return
+     */
+    static QString calcKey(const QString& compilerSetId,
+                           ParserLanguage language,
+                           const QList<QString>& includePaths,
+                           const DefineMap& hardDefines);
+    static QString cacheFileName(const QString& cacheFolder, const QString& key);
+    static bool save(const QString& fileName, const PSystemHeaderSymbols& symbols);
+    /**
+     * @brief load symbols from the cache file
+     * @return nullptr if the cache doesn't exist, is of a different key/version,
+     * or any header in it has been modified after the cache was saved.
+     */
+    static PSystemHeaderSymbols load(const QString& fileName, const QString& key);
+    static qint64 fileTimestamp(const QString& fileName);
+
+    /**
+     * @brief get the snapshot currently used by other parsers
+     * @return nullptr if no alive parser is using a snapshot of the key
+     */
+    static PSystemHeaderSymbols sharedSymbols(const QString& key);
+    /**
+     * @brief publish the snapshot, so parsers of the same key can use it.
+     * The registry doesn't own the snapshot; it's released with the last parser using it.
+     */
+    static void shareSymbols(const PSystemHeaderSymbols& symbols);
+private:
+    static QMutex mSharedSymbolsMutex;
+    static QHash<QString, std::weak_ptr<SystemHeaderSymbols>> mSharedSymbols;
+};
+
+#endif // SYSTEMHEADERCACHE_H
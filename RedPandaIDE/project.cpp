@@ -104,6 +104,8 @@ std::shared_ptr<Project> Project::create(
 
 Project::~Project()
 {
+    // don't keep parsing files of the closed project
+    ParseScheduler::instance()->cancelRequests(mParser);
     mFileSystemWatcher->removePath(directory());
     mEditorList->beginUpdate();
     foreach (const PProjectUnit& unit, mUnits) {
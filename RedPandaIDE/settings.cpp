@@ -4149,6 +4149,26 @@ void Settings::CodeCompletion::setShareParser(bool newShareParser)
     mShareParser = newShareParser;
 }
 
+bool Settings::CodeCompletion::cacheSystemHeaders() const
+{
+    return mCacheSystemHeaders;
+}
+
+void Settings::CodeCompletion::setCacheSystemHeaders(bool newCacheSystemHeaders)
+{
+    mCacheSystemHeaders = newCacheSystemHeaders;
+}
+
+bool Settings::CodeCompletion::parallelParsing() const
+{
+    return mParallelParsing;
+}
+
+void Settings::CodeCompletion::setParallelParsing(bool newParallelParsing)
+{
+    mParallelParsing = newParallelParsing;
+}
+
 bool Settings::CodeCompletion::hideSymbolsStartsWithUnderLine() const
 {
     return mHideSymbolsStartsWithUnderLine;
@@ -4288,6 +4308,8 @@ void Settings::CodeCompletion::doSave()
     saveValue("hide_symbols_start_with_two_underline", mHideSymbolsStartsWithTwoUnderLine);
     saveValue("hide_symbols_start_with_underline", mHideSymbolsStartsWithUnderLine);
     saveValue("share_parser",mShareParser);
+    saveValue("cache_system_headers",mCacheSystemHeaders);
+    saveValue("parallel_parsing",mParallelParsing);
 }
 
 
@@ -4340,6 +4362,8 @@ void Settings::CodeCompletion::doLoad()
 //#endif
     mClearWhenEditorHidden = boolValue("clear_when_editor_hidden",doClear);
     mShareParser = boolValue("share_parser",shouldShare);
+    mCacheSystemHeaders = boolValue("cache_system_headers",true);
+    mParallelParsing = boolValue("parallel_parsing",true);
 }
 
 Settings::CodeFormatter::CodeFormatter(Settings *settings):
@@ -668,6 +668,12 @@ public:
         bool shareParser();
         void setShareParser(bool newShareParser);
 
+        bool cacheSystemHeaders() const;
+        void setCacheSystemHeaders(bool newCacheSystemHeaders);
+
+        bool parallelParsing() const;
+        void setParallelParsing(bool newParallelParsing);
+
     private:
         int mWidth;
         int mHeight;
@@ -686,6 +692,8 @@ public:
         bool mHideSymbolsStartsWithUnderLine;
         bool mClearWhenEditorHidden;
         bool mShareParser;
+        bool mCacheSystemHeaders;
+        bool mParallelParsing;
 
         // _Base interface
     protected:
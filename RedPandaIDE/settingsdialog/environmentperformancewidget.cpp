@@ -53,6 +53,8 @@ void EnvironmentPerformanceWidget::doLoad()
 //    }
 //#endif
     ui->chkEditorsShareParser->setChecked(pSettings->codeCompletion().shareParser());
+    ui->chkCacheSystemHeaders->setChecked(pSettings->codeCompletion().cacheSystemHeaders());
+    ui->chkParallelParsing->setChecked(pSettings->codeCompletion().parallelParsing());
     ui->spinMaxUndoMemory->setValue(pSettings->editor().undoMemoryUsage());
 }
 
@@ -60,6 +62,8 @@ void EnvironmentPerformanceWidget::doSave()
 {
     pSettings->codeCompletion().setClearWhenEditorHidden(ui->chkClearWhenEditorHidden->isChecked());
     pSettings->codeCompletion().setShareParser(ui->chkEditorsShareParser->isChecked());
+    pSettings->codeCompletion().setCacheSystemHeaders(ui->chkCacheSystemHeaders->isChecked());
+    pSettings->codeCompletion().setParallelParsing(ui->chkParallelParsing->isChecked());
 
     pSettings->codeCompletion().save();
     pSettings->editor().setUndoMemoryUsage(ui->spinMaxUndoMemory->value());
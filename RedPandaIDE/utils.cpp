@@ -309,6 +309,7 @@ void resetCppParser(std::shared_ptr<CppParser> parser, int compilerSetIndex)
     parser->setEnabled(true);
     parser->setParseGlobalHeaders(true);
     parser->setParseLocalHeaders(true);
+    parser->setParallelParsing(pSettings->codeCompletion().parallelParsing());
     // Set options depending on the current compiler set
     if (compilerSetIndex<0) {
         compilerSetIndex=pSettings->compilerSets().defaultIndex();
@@ -346,6 +347,15 @@ void resetCppParser(std::shared_ptr<CppParser> parser, int compilerSetIndex)
         parser->addHardDefineByLine("#define __TIME__  1");
     }
     parser->parseHardDefines();
+    if (compilerSet) {
+        parser->setSystemHeaderCache(
+                    QString("%1 %2 %3").arg(compilerSet->name(),
+                                            compilerSet->CCompiler(),
+                                            compilerSet->version()),
+                    pSettings->codeCompletion().cacheSystemHeaders()?
+                        includeTrailingPathDelimiter(pSettings->dirs().config())+"parser-cache"
+                      : QString());
+    }
     pMainWindow->disconnect(parser.get(),
                             &CppParser::onStartParsing,
                             pMainWindow,
@@ -238,7 +238,7 @@ void ClassBrowserModel::fillStatements()
             return;
         if (!mParser->enabled())
             return;
-        if (!mParser->freeze())
+        if (!mParser->tryFreeze())
             return;
         QString mParserSerialId = mParser->serialId();
         addMembers();
@@ -380,6 +380,10 @@ void ClassBrowserModel::filterChildren(ClassBrowserNode *node, const StatementMa
                 scopeNode = addChild(parentNode,dummy);
             }
             filterChildren(scopeNode.get(),statement->children);
+            //inherited members are not children of the class, ask the parser for them
+            if (pSettings->ui().classBrowserShowInherited()
+                    && !statement->baseClasses.isEmpty())
+                filterChildren(scopeNode.get(),mParser->getInheritedMembers(statement));
         } else {
             addChild(parentNode,statement);
         }
@@ -39,7 +39,7 @@ CodeCompletionPopup::CodeCompletionPopup(QWidget *parent) :
 {
     setWindowFlags(Qt::Popup);
     mListView = new CodeCompletionListView(this);
-    mModel=new CodeCompletionListModel(&mCompletionStatementList);
+    mModel=new CodeCompletionListModel(&mCompletionStatementList, &mMatches, &mMatchPositions);
     mDelegate = new CodeCompletionListItemDelegate(mModel,this);
     QItemSelectionModel *m=mListView->selectionModel();
     mListView->setModel(mModel);
@@ -54,6 +54,7 @@ CodeCompletionPopup::CodeCompletionPopup(QWidget *parent) :
     mSortByScope = true;
 
     mShowCount = 1000;
+    mFilterValid = false;
     mShowCodeSnippets = true;
 
     mIgnoreCase = false;
@@ -92,16 +93,17 @@ void CodeCompletionPopup::prepareSearch(
 
     mMemberPhrase = memberExpression.join("");
     mMemberOperator = memberOperator;
+    resetFilter();
     switch(type) {
     case CodeCompletionType::ComplexKeyword:
         getCompletionListForTypeKeywordComplex(preWord);
         break;
     case CodeCompletionType::FunctionWithoutDefinition:
-        mIncludedFiles = mParser->getFileIncludes(filename);
+        mIncludedFiles = mParser->getFileIncludeIds(filename);
         getCompletionForFunctionWithoutDefinition(preWord, ownerExpression,memberOperator,memberExpression, filename,line);
         break;
     case CodeCompletionType::Namespaces:
-        mIncludedFiles = mParser->getFileIncludes(filename);
+        mIncludedFiles = mParser->getFileIncludeIds(filename);
         getCompletionListForNamespaces(preWord,filename,line);
         break;
     case CodeCompletionType::KeywordsOnly:
@@ -109,7 +111,7 @@ void CodeCompletionPopup::prepareSearch(
         getKeywordCompletionFor(customKeywords);
         break;
     default:
-        mIncludedFiles = mParser->getFileIncludes(filename);
+        mIncludedFiles = mParser->getFileIncludeIds(filename);
         getCompletionFor(ownerExpression,memberOperator,memberExpression, filename,line, customKeywords);
     }
     setCursor(oldCursor);
@@ -188,11 +190,11 @@ void CodeCompletionPopup::addChildren(const PStatement& scopeStatement,
                                       int line,
                                       bool onlyTypes)
 {
-    if (scopeStatement && !isIncluded(scopeStatement->fileName)
-      && !isIncluded(scopeStatement->definitionFileName))
+    if (scopeStatement && !isIncluded(scopeStatement->fileId)
+      && !isIncluded(scopeStatement->definitionFileId))
         return;
     const StatementMap& children = mParser->statementList().childrenStatements(scopeStatement);
-    if (children.isEmpty())
+    if (children.isEmpty() && (!scopeStatement || scopeStatement->baseClasses.isEmpty()))
         return;
 
     if (onlyTypes) {
@@ -204,15 +206,15 @@ void CodeCompletionPopup::addChildren(const PStatement& scopeStatement,
                     // hard defines
                     addStatement(childStatement,fileName,-1);
                 } else if (
-                           isIncluded(childStatement->fileName)
-                           || isIncluded(childStatement->definitionFileName)
+                           isIncluded(childStatement->fileId)
+                           || isIncluded(childStatement->definitionFileId)
                            ) {
                     //we must check if the statement is included by the file
                     addStatement(childStatement,fileName,line);
                 }
             }
         } else {
-            for (const PStatement& childStatement: children) {
+            foreach (const PStatement& childStatement, classMembers(scopeStatement)) {
                 if (!isTypeKind(childStatement->kind))
                     continue;
                 addStatement(childStatement,fileName,line);
@@ -225,15 +227,15 @@ void CodeCompletionPopup::addChildren(const PStatement& scopeStatement,
                     // hard defines
                     addStatement(childStatement,fileName,-1);
                 } else if (
-                           isIncluded(childStatement->fileName)
-                           || isIncluded(childStatement->definitionFileName)
+                           isIncluded(childStatement->fileId)
+                           || isIncluded(childStatement->definitionFileId)
                            ) {
                     //we must check if the statement is included by the file
                     addStatement(childStatement,fileName,line);
                 }
             }
         } else {
-            for (const PStatement& childStatement: children) {
+            foreach (const PStatement& childStatement, classMembers(scopeStatement)) {
                 addStatement(childStatement,fileName,line);
             }
         }
@@ -243,8 +245,8 @@ void CodeCompletionPopup::addChildren(const PStatement& scopeStatement,
 
 void CodeCompletionPopup::addFunctionWithoutDefinitionChildren(const PStatement& scopeStatement, const QString &fileName, int line)
 {
-    if (scopeStatement && !isIncluded(scopeStatement->fileName)
-      && !isIncluded(scopeStatement->definitionFileName))
+    if (scopeStatement && !isIncluded(scopeStatement->fileId)
+      && !isIncluded(scopeStatement->definitionFileId))
         return;
     const StatementMap& children = mParser->statementList().childrenStatements(scopeStatement);
     if (children.isEmpty())
@@ -266,7 +268,7 @@ void CodeCompletionPopup::addFunctionWithoutDefinitionChildren(const PStatement&
             break;
         case StatementKind::skClass:
         case StatementKind::skNamespace:
-            if (isIncluded(childStatement->fileName))
+            if (isIncluded(childStatement->fileId))
                 addStatement(childStatement,fileName,line);
             break;
         default:
@@ -275,6 +277,14 @@ void CodeCompletionPopup::addFunctionWithoutDefinitionChildren(const PStatement&
     }
 }
 
+StatementList CodeCompletionPopup::classMembers(const PStatement &classStatement)
+{
+    StatementList members = mParser->statementList().childrenStatements(classStatement).values();
+    //inherited members are added after the class's own ones, so they are hidden by them
+    members.append(mParser->getInheritedMembers(classStatement).values());
+    return members;
+}
+
 void CodeCompletionPopup::addStatement(const PStatement& statement, const QString &fileName, int line)
 {
     if (mAddedStatements.contains(statement->command))
@@ -292,19 +302,21 @@ void CodeCompletionPopup::addStatement(const PStatement& statement, const QStrin
     mFullCompletionStatementList.append(statement);
 }
 
-static bool nameComparator(PStatement statement1,PStatement statement2) {
+static bool nameComparator(const Statement* statement1,const Statement* statement2) {
     return statement1->command < statement2->command;
 }
 
-static bool defaultComparator(PStatement statement1,PStatement statement2) {
-    if (statement1->matchPosSpan!=statement2->matchPosSpan)
-        return statement1->matchPosSpan < statement2->matchPosSpan;
-    if (statement1->firstMatchLength != statement2->firstMatchLength)
-        return statement1->firstMatchLength > statement2->firstMatchLength;
-    if (statement1->matchPosTotal != statement2->matchPosTotal)
-        return statement1->matchPosTotal < statement2->matchPosTotal;
-    if (statement1->caseMatched != statement2->caseMatched)
-        return statement1->caseMatched > statement2->caseMatched;
+static bool defaultComparator(const CompletionMatch& match1, const CompletionMatch& match2){
+    Statement* statement1 = match1.statement;
+    Statement* statement2 = match2.statement;
+    if (match1.matchPosSpan!=match2.matchPosSpan)
+        return match1.matchPosSpan < match2.matchPosSpan;
+    if (match1.firstMatchLength != match2.firstMatchLength)
+        return match1.firstMatchLength > match2.firstMatchLength;
+    if (match1.matchPosTotal != match2.matchPosTotal)
+        return match1.matchPosTotal < match2.matchPosTotal;
+    if (match1.caseMatched != match2.caseMatched)
+        return match1.caseMatched > match2.caseMatched;
     // Show user template first
     if (statement1->kind == StatementKind::skUserCodeSnippet) {
         if (statement2->kind != StatementKind::skUserCodeSnippet)
@@ -324,15 +336,17 @@ static bool defaultComparator(PStatement statement1,PStatement statement2) {
         return nameComparator(statement1,statement2);
 }
 
-static bool sortByScopeComparator(PStatement statement1,PStatement statement2){
-    if (statement1->matchPosSpan!=statement2->matchPosSpan)
-        return statement1->matchPosSpan < statement2->matchPosSpan;
-    if (statement1->firstMatchLength != statement2->firstMatchLength)
-        return statement1->firstMatchLength > statement2->firstMatchLength;
-    if (statement1->matchPosTotal != statement2->matchPosTotal)
-        return statement1->matchPosTotal < statement2->matchPosTotal;
-    if (statement1->caseMatched != statement2->caseMatched)
-        return statement1->caseMatched > statement2->caseMatched;
+static bool sortByScopeComparator(const CompletionMatch& match1, const CompletionMatch& match2){
+    Statement* statement1 = match1.statement;
+    Statement* statement2 = match2.statement;
+    if (match1.matchPosSpan!=match2.matchPosSpan)
+        return match1.matchPosSpan < match2.matchPosSpan;
+    if (match1.firstMatchLength != match2.firstMatchLength)
+        return match1.firstMatchLength > match2.firstMatchLength;
+    if (match1.matchPosTotal != match2.matchPosTotal)
+        return match1.matchPosTotal < match2.matchPosTotal;
+    if (match1.caseMatched != match2.caseMatched)
+        return match1.caseMatched > match2.caseMatched;
     // Show user template first
     if (statement1->kind == StatementKind::skUserCodeSnippet) {
         if (statement2->kind != StatementKind::skUserCodeSnippet)
@@ -368,15 +382,17 @@ static bool sortByScopeComparator(PStatement statement1,PStatement statement2){
         return nameComparator(statement1,statement2);
 }
 
-static bool sortWithUsageComparator(PStatement statement1,PStatement statement2) {
-    if (statement1->matchPosSpan!=statement2->matchPosSpan)
-        return statement1->matchPosSpan < statement2->matchPosSpan;
-    if (statement1->firstMatchLength != statement2->firstMatchLength)
-        return statement1->firstMatchLength > statement2->firstMatchLength;
-    if (statement1->matchPosTotal != statement2->matchPosTotal)
-        return statement1->matchPosTotal < statement2->matchPosTotal;
-    if (statement1->caseMatched != statement2->caseMatched)
-        return statement1->caseMatched > statement2->caseMatched;
+static bool sortWithUsageComparator(const CompletionMatch& match1, const CompletionMatch& match2){
+    Statement* statement1 = match1.statement;
+    Statement* statement2 = match2.statement;
+    if (match1.matchPosSpan!=match2.matchPosSpan)
+        return match1.matchPosSpan < match2.matchPosSpan;
+    if (match1.firstMatchLength != match2.firstMatchLength)
+        return match1.firstMatchLength > match2.firstMatchLength;
+    if (match1.matchPosTotal != match2.matchPosTotal)
+        return match1.matchPosTotal < match2.matchPosTotal;
+    if (match1.caseMatched != match2.caseMatched)
+        return match1.caseMatched > match2.caseMatched;
     // Show user template first
     if (statement1->kind == StatementKind::skUserCodeSnippet) {
         if (statement2->kind != StatementKind::skUserCodeSnippet)
@@ -400,15 +416,17 @@ static bool sortWithUsageComparator(PStatement statement1,PStatement statement2)
         return nameComparator(statement1,statement2);
 }
 
-static bool sortByScopeWithUsageComparator(PStatement statement1,PStatement statement2){
-    if (statement1->matchPosSpan!=statement2->matchPosSpan)
-        return statement1->matchPosSpan < statement2->matchPosSpan;
-    if (statement1->firstMatchLength != statement2->firstMatchLength)
-        return statement1->firstMatchLength > statement2->firstMatchLength;
-    if (statement1->matchPosTotal != statement2->matchPosTotal)
-        return statement1->matchPosTotal < statement2->matchPosTotal;
-    if (statement1->caseMatched != statement2->caseMatched)
-        return statement1->caseMatched > statement2->caseMatched;
+static bool sortByScopeWithUsageComparator(const CompletionMatch& match1, const CompletionMatch& match2){
+    Statement* statement1 = match1.statement;
+    Statement* statement2 = match2.statement;
+    if (match1.matchPosSpan!=match2.matchPosSpan)
+        return match1.matchPosSpan < match2.matchPosSpan;
+    if (match1.firstMatchLength != match2.firstMatchLength)
+        return match1.firstMatchLength > match2.firstMatchLength;
+    if (match1.matchPosTotal != match2.matchPosTotal)
+        return match1.matchPosTotal < match2.matchPosTotal;
+    if (match1.caseMatched != match2.caseMatched)
+        return match1.caseMatched > match2.caseMatched;
     // Show user template first
     if (statement1->kind == StatementKind::skUserCodeSnippet) {
         if (statement2->kind != StatementKind::skUserCodeSnippet)
@@ -449,6 +467,84 @@ static bool sortByScopeWithUsageComparator(PStatement statement1,PStatement stat
         return nameComparator(statement1,statement2);
 }
 
+// most identifiers are ascii, don't look them up in the unicode tables
+static inline QChar foldedChar(QChar ch)
+{
+    ushort code = ch.unicode();
+    if (code < 128) {
+        if (code>='A' && code<='Z')
+            return QChar(ushort(code + ('a'-'A')));
+        return ch;
+    }
+    return ch.toCaseFolded();
+}
+
+// the same as comparing with QString::indexOf(ch, pos, Qt::CaseInsensitive)
+static QString foldedString(const QString& s)
+{
+    QString result(s.length(), Qt::Uninitialized);
+    const QChar* source = s.constData();
+    QChar* dest = result.data();
+    for (int i=0;i<s.length();i++)
+        dest[i] = foldedChar(source[i]);
+    return result;
+}
+
+// Finds the chars of the phrase in the command one after another,
+// and appends spans of the matched chars to positions.
+static bool matchSubsequence(const QString& command,
+                             const QString& searchedCommand,
+                             const QString& phrase,
+                             const QString& searchedPhrase,
+                             CompletionMatch& match,
+                             QVector<StatementMatchPosition>& positions)
+{
+    const QChar* commandChars = command.constData();
+    const QChar* target = searchedCommand.constData();
+    const QChar* phraseChars = phrase.constData();
+    const QChar* searched = searchedPhrase.constData();
+    int commandLen = command.length();
+    int len = phrase.length();
+    int pos = 0;
+    int lastPos = -10;
+    int totalPos = 0;
+    int caseMatched = 0;
+    match.firstPosition = positions.count();
+    for (int i=0;i<len;i++) {
+        while (pos<commandLen && target[pos]!=searched[i])
+            pos++;
+        if (pos>=commandLen) {
+            positions.resize(match.firstPosition);
+            return false;
+        }
+        if (pos == lastPos+1) {
+            positions.last().end++;
+        } else {
+            StatementMatchPosition matchPosition;
+            matchPosition.start = pos;
+            matchPosition.end = pos+1;
+            positions.append(matchPosition);
+        }
+        if (phraseChars[i]==commandChars[pos])
+            caseMatched++;
+        totalPos += pos;
+        lastPos = pos;
+        pos+=1;
+    }
+    match.positionCount = positions.count() - match.firstPosition;
+    match.caseMatched = caseMatched;
+    match.matchPosTotal = totalPos;
+    if (len>0) {
+        const StatementMatchPosition& first = positions[match.firstPosition];
+        match.firstMatchLength = first.end - first.start;
+        match.matchPosSpan = positions.last().end - first.start;
+    } else {
+        match.firstMatchLength = 0;
+        match.matchPosSpan = 0;
+    }
+    return true;
+}
+
 void CodeCompletionPopup::filterList(const QString &member)
 {
     QMutexLocker locker(&mMutex);
@@ -460,79 +556,59 @@ void CodeCompletionPopup::filterList(const QString &member)
     //we don't need to freeze here since we use smart pointers
     //  and data have been retrieved from the parser
 
-    mCompletionStatementList.clear();
-    mCompletionStatementList.reserve(mFullCompletionStatementList.size());
     bool hideSymbolsTwoUnderline = mHideSymbolsStartWithTwoUnderline && !member.startsWith("__") ;
     bool hideSymbolsUnderline = mHideSymbolsStartWithUnderline && !member.startsWith("_") ;
-    int len = member.length();
-    foreach (const PStatement& statement, mFullCompletionStatementList) {
-
-        int matched = 0;
-        int caseMatched = 0;
-        QString command = statement->command;
-        int pos = 0;
-        int lastPos = -10;
-        int totalPos = 0;
-        statement->matchPositions.clear();
-        if (hideSymbolsTwoUnderline && statement->command.startsWith("__")) {
+    // when the phrase grows, only statements matched last time can match it
+    bool narrowing = mFilterValid
+            && member.startsWith(mFilteredPhrase)
+            && mFilteredIgnoreCase == mIgnoreCase
+            && mFilteredHideTwoUnderline == hideSymbolsTwoUnderline
+            && mFilteredHideUnderline == hideSymbolsUnderline;
+    if (mIgnoreCase && mFoldedCommands.count()!=mFullCompletionStatementList.count()) {
+        mFoldedCommands.clear();
+        mFoldedCommands.reserve(mFullCompletionStatementList.count());
+        foreach (const PStatement& statement, mFullCompletionStatementList)
+            mFoldedCommands.append(foldedString(statement->command));
+    }
+    QString searchedPhrase = mIgnoreCase?foldedString(member):member;
+    int candidateCount = narrowing?mMatches.count():mFullCompletionStatementList.count();
+    if (!narrowing)
+        mMatches.resize(candidateCount);
+    // match positions are recomputed for every candidate, the buffer is reused
+    mMatchPositions.clear();
+    int matchedCount = 0;
+    for (int i=0;i<candidateCount;i++) {
+        // candidates before i are already checked, so the match is written in place
+        int index = narrowing?mMatches[i].index:i;
+        const PStatement& statement = mFullCompletionStatementList[index];
+        if (hideSymbolsTwoUnderline && statement->command.startsWith("__"))
             continue;
-        } else if (hideSymbolsUnderline && statement->command.startsWith("_")) {
+        if (hideSymbolsUnderline && statement->command.startsWith("_"))
             continue;
-        } else {
-            foreach (const QChar& ch, member) {
-                if (mIgnoreCase)
-                    pos = command.indexOf(ch,pos,Qt::CaseInsensitive);
-                else
-                    pos = command.indexOf(ch,pos,Qt::CaseSensitive);
-                if (pos<0) {
-                    break;
-                }
-                if (pos == lastPos+1) {
-                    statement->matchPositions.last()->end++;
-                } else {
-                    PStatementMathPosition matchPosition=std::make_shared<StatementMatchPosition>();
-                    matchPosition->start = pos;
-                    matchPosition->end = pos+1;
-                    statement->matchPositions.append(matchPosition);
-                }
-                if (ch==command[pos])
-                    caseMatched++;
-                matched++;
-                totalPos += pos;
-                lastPos = pos;
-                pos+=1;
-            }
-        }
-
-        if (mIgnoreCase && matched== len) {
-            statement->caseMatched = caseMatched;
-            statement->matchPosTotal = totalPos;
-            if (member.length()>0) {
-                statement->firstMatchLength = statement->matchPositions.front()->end - statement->matchPositions.front()->start;
-                statement->matchPosSpan = statement->matchPositions.last()->end - statement->matchPositions.front()->start;
-            } else
-                statement->firstMatchLength = 0;
-            mCompletionStatementList.append(statement);
-        } else if (caseMatched == len) {
-            statement->caseMatched = caseMatched;
-            statement->matchPosTotal = totalPos;
-            if (member.length()>0) {
-                statement->firstMatchLength = statement->matchPositions.front()->end - statement->matchPositions.front()->start;
-                statement->matchPosSpan = statement->matchPositions.last()->end - statement->matchPositions.front()->start;
-            } else
-                statement->firstMatchLength = 0;
-            mCompletionStatementList.append(statement);
-        } else {
-            statement->matchPositions.clear();
-            statement->caseMatched = 0;
-            statement->matchPosTotal = 0;
-            statement->firstMatchLength = 0;
-            statement->matchPosSpan = 0;
-        }
+        CompletionMatch& match = mMatches[matchedCount];
+        if (!matchSubsequence(statement->command,
+                              mIgnoreCase?mFoldedCommands[index]:statement->command,
+                              member,
+                              searchedPhrase,
+                              match,
+                              mMatchPositions))
+            continue;
+        match.index = index;
+        match.statement = statement.get();
+        matchedCount++;
     }
+    mMatches.resize(matchedCount);
+    mFilterValid = true;
+    mFilteredPhrase = member;
+    mFilteredIgnoreCase = mIgnoreCase;
+    mFilteredHideTwoUnderline = hideSymbolsTwoUnderline;
+    mFilteredHideUnderline = hideSymbolsUnderline;
+
+    bool (*comparator)(const CompletionMatch&, const CompletionMatch&);
     if (mRecordUsage) {
         int usageCount;
-        foreach (const PStatement& statement,mCompletionStatementList) {
+        foreach (const CompletionMatch& match,mMatches) {
+            Statement* statement = match.statement;
             if (statement->usageCount == -1) {
                 PSymbolUsage usage = pMainWindow->symbolUsageManager()->findUsage(statement->fullName);
                 if (usage) {
@@ -544,24 +620,24 @@ void CodeCompletionPopup::filterList(const QString &member)
             }
         }
         if (mSortByScope) {
-            std::sort(mCompletionStatementList.begin(),
-                      mCompletionStatementList.end(),
-                      sortByScopeWithUsageComparator);
+            comparator = sortByScopeWithUsageComparator;
         } else {
-            std::sort(mCompletionStatementList.begin(),
-                      mCompletionStatementList.end(),
-                      sortWithUsageComparator);
+            comparator = sortWithUsageComparator;
         }
     } else if (mSortByScope) {
-        std::sort(mCompletionStatementList.begin(),
-                  mCompletionStatementList.end(),
-                  sortByScopeComparator);
+        comparator = sortByScopeComparator;
     } else {
-        std::sort(mCompletionStatementList.begin(),
-                  mCompletionStatementList.end(),
-                  defaultComparator);
+        comparator = defaultComparator;
     }
-    //    }
+    // only the first mShowCount rows are listed, don't sort the others
+    int showCount = std::min(mShowCount, mMatches.count());
+    std::partial_sort(mMatches.begin(),
+                      mMatches.begin()+showCount,
+                      mMatches.end(),
+                      comparator);
+    mCompletionStatementList.reserve(showCount);
+    for (int i=0;i<showCount;i++)
+        mCompletionStatementList.append(mFullCompletionStatementList[mMatches[i].index]);
 }
 
 void CodeCompletionPopup::getKeywordCompletionFor(const QSet<QString> &customKeywords)
@@ -645,7 +721,7 @@ void CodeCompletionPopup::getCompletionFor(
     if (!mParser || !mParser->enabled())
         return;
 
-    if (!mParser->freeze())
+    if (!mParser->tryFreeze())
         return;
     {
         auto action = finally([this]{
@@ -795,17 +871,14 @@ void CodeCompletionPopup::getCompletionFor(
                     if (memberOperator=="->" && ownerStatement->pointerLevel!=1)
                         return;
                 }
-                if (!isIncluded(classTypeStatement->fileName) &&
-                    !isIncluded(classTypeStatement->definitionFileName))
+                if (!isIncluded(classTypeStatement->fileId) &&
+                    !isIncluded(classTypeStatement->definitionFileId))
                     return;
                 if ((classTypeStatement == scopeTypeStatement) || (ownerStatement->effectiveTypeStatement->command == "this")) {
                     //we can use all members
                     addChildren(classTypeStatement,fileName,-1);
                 } else { // we can only use public members
-                    const StatementMap& children = mParser->statementList().childrenStatements(classTypeStatement);
-                    if (children.isEmpty())
-                        return;
-                    foreach (const PStatement& childStatement, children) {
+                    foreach (const PStatement& childStatement, classMembers(classTypeStatement)) {
                         if ((childStatement->accessibility==StatementAccessibility::Public)
                                 && !(
                                     childStatement->kind == StatementKind::skConstructor
@@ -822,8 +895,8 @@ void CodeCompletionPopup::getCompletionFor(
                 PStatement classTypeStatement = ownerStatement->effectiveTypeStatement;
                 if (!classTypeStatement)
                     return;
-                if (!isIncluded(classTypeStatement->fileName) &&
-                    !isIncluded(classTypeStatement->definitionFileName))
+                if (!isIncluded(classTypeStatement->fileId) &&
+                    !isIncluded(classTypeStatement->definitionFileId))
                     return;
                 if (classTypeStatement->kind == StatementKind::skEnumType
                         || classTypeStatement->kind == StatementKind::skEnumClassType) {
@@ -836,9 +909,7 @@ void CodeCompletionPopup::getCompletionFor(
                     //class
                     if (classTypeStatement == scopeTypeStatement) {
                         //we can use all static members
-                        const StatementMap& children =
-                                mParser->statementList().childrenStatements(classTypeStatement);
-                        foreach (const PStatement& childStatement, children) {
+                        foreach (const PStatement& childStatement, classMembers(classTypeStatement)) {
                             if (
                               (childStatement->isStatic())
                                || (childStatement->kind == StatementKind::skTypedef
@@ -852,9 +923,7 @@ void CodeCompletionPopup::getCompletionFor(
                         }
                     } else {
                         // we can only use public static members
-                        const StatementMap& children =
-                                mParser->statementList().childrenStatements(classTypeStatement);
-                        foreach (const PStatement& childStatement,children) {
+                        foreach (const PStatement& childStatement, classMembers(classTypeStatement)) {
                             if (
                               (childStatement->isStatic())
                                || (childStatement->kind == StatementKind::skTypedef
@@ -884,7 +953,7 @@ void CodeCompletionPopup::getCompletionForFunctionWithoutDefinition(const QStrin
     if (memberOperator.isEmpty() && ownerExpression.isEmpty() && memberExpression.isEmpty())
         return;
 
-    if (!mParser->freeze())
+    if (!mParser->tryFreeze())
         return;
     {
         auto action = finally([this]{
@@ -991,7 +1060,7 @@ void CodeCompletionPopup::getCompletionListForNamespaces(const QString &/*preWor
     if (!mParser->enabled())
         return;
 
-    if (!mParser->freeze())
+    if (!mParser->tryFreeze())
         return;
     {
         auto action = finally([this]{
@@ -1001,8 +1070,8 @@ void CodeCompletionPopup::getCompletionListForNamespaces(const QString &/*preWor
         foreach (const QString& name, namespaceNames) {
             PStatementList namespaces = mParser->findNamespace(name);
             foreach(const PStatement& statement, *namespaces) {
-                if (isIncluded(statement->fileName)
-                        || isIncluded(statement->definitionFileName)) {
+                if (isIncluded(statement->fileId)
+                        || isIncluded(statement->definitionFileId)) {
                     addStatement(statement,fileName,line);
                     continue;
                 }
@@ -1022,9 +1091,9 @@ void CodeCompletionPopup::addKeyword(const QString &keyword)
     mFullCompletionStatementList.append(statement);
 }
 
-bool CodeCompletionPopup::isIncluded(const QString &fileName)
+bool CodeCompletionPopup::isIncluded(int fileId)
 {
-    return mIncludedFiles.contains(fileName);
+    return mIncludedFiles.contains(fileId);
 }
 
 void CodeCompletionPopup::setHideSymbolsStartWithTwoUnderline(bool newHideSymbolsStartWithTwoUnderline)
@@ -1152,6 +1221,15 @@ void CodeCompletionPopup::setShowCount(int newShowCount)
     mShowCount = newShowCount;
 }
 
+void CodeCompletionPopup::resetFilter()
+{
+    mFilterValid = false;
+    mFilteredPhrase.clear();
+    mMatches.clear();
+    mMatchPositions.clear();
+    mFoldedCommands.clear();
+}
+
 const PCppParser &CodeCompletionPopup::parser() const
 {
     return mParser;
@@ -1167,10 +1245,8 @@ void CodeCompletionPopup::hideEvent(QHideEvent *event)
     QMutexLocker locker(&mMutex);
     mListView->setKeypressedCallback(nullptr);
     mCompletionStatementList.clear();
-//    foreach (PStatement statement, mFullCompletionStatementList) {
-//        statement->matchPositions.clear();
-//    }
     mFullCompletionStatementList.clear();
+    resetFilter();
     mIncludedFiles.clear();
     mUsings.clear();
     mAddedStatements.clear();
@@ -1189,9 +1265,14 @@ bool CodeCompletionPopup::event(QEvent *event)
     return result;
 }
 
-CodeCompletionListModel::CodeCompletionListModel(const StatementList *statements, QObject *parent):
+CodeCompletionListModel::CodeCompletionListModel(const StatementList *statements,
+                                                 const QVector<CompletionMatch>* matches,
+                                                 const QVector<StatementMatchPosition>* matchPositions,
+                                                 QObject *parent):
     QAbstractListModel(parent),
-    mStatements(statements)
+    mStatements(statements),
+    mMatches(matches),
+    mMatchPositions(matchPositions)
 {
 
 }
@@ -1239,6 +1320,18 @@ QPixmap CodeCompletionListModel::statementIcon(const QModelIndex &index) const
     return pIconsManager->getPixmapForStatement(statement);
 }
 
+const StatementMatchPosition *CodeCompletionListModel::matchPositions(const QModelIndex &index, int &count) const
+{
+    count = 0;
+    if (!index.isValid())
+        return nullptr;
+    if (index.row()>=mStatements->count() || index.row()>=mMatches->count())
+        return nullptr;
+    const CompletionMatch& match = mMatches->at(index.row());
+    count = match.positionCount;
+    return mMatchPositions->constData()+match.firstPosition;
+}
+
 void CodeCompletionListModel::notifyUpdated()
 {
     beginResetModel();
@@ -1265,18 +1358,21 @@ void CodeCompletionListItemDelegate::paint(QPainter *painter, const QStyleOption
         QString text = statement->command;
         int pos=0;
         int y=option.rect.bottom()-painter->fontMetrics().descent();
-        foreach (const PStatementMathPosition& matchPosition, statement->matchPositions) {
-            if (pos<matchPosition->start) {
-                QString t = text.mid(pos,matchPosition->start-pos);
+        int positionCount;
+        const StatementMatchPosition* matchPositions = mModel->matchPositions(index, positionCount);
+        for (int i=0;i<positionCount;i++) {
+            const StatementMatchPosition& matchPosition = matchPositions[i];
+            if (pos<matchPosition.start) {
+                QString t = text.mid(pos,matchPosition.start-pos);
                 painter->setPen(normalColor);
                 painter->drawText(x,y,t);
                 x+=painter->fontMetrics().horizontalAdvance(t);
             }
-            QString t = text.mid(matchPosition->start, matchPosition->end-matchPosition->start);
+            QString t = text.mid(matchPosition.start, matchPosition.end-matchPosition.start);
             painter->setPen(mMatchedColor);
             painter->drawText(x,y,t);
             x+=painter->fontMetrics().horizontalAdvance(t);
-            pos=matchPosition->end;
+            pos=matchPosition.end;
         }
         if (pos<text.length()) {
             QString t = text.mid(pos,text.length()-pos);
@@ -23,18 +23,36 @@
 #include "codecompletionlistview.h"
 
 class ColorSchemeItem;
+
+struct CompletionMatch {
+    int index; // in the full completion list
+    Statement* statement;
+    int matchPosTotal; // total of matched positions
+    int matchPosSpan; // distance between the first match pos and the last match pos;
+    int firstMatchLength; // length of first match;
+    int caseMatched; // if match with case
+    int firstPosition; // of the match positions in the position buffer
+    int positionCount;
+};
+
 class CodeCompletionListModel : public QAbstractListModel {
     Q_OBJECT
 public:
-    explicit CodeCompletionListModel(const StatementList* statements,QObject *parent = nullptr);
+    explicit CodeCompletionListModel(const StatementList* statements,
+                                     const QVector<CompletionMatch>* matches,
+                                     const QVector<StatementMatchPosition>* matchPositions,
+                                     QObject *parent = nullptr);
     int rowCount(const QModelIndex &parent) const override;
     QVariant data(const QModelIndex &index, int role) const override;
     PStatement statement(const QModelIndex &index) const;
     QPixmap statementIcon(const QModelIndex &index) const;
+    const StatementMatchPosition* matchPositions(const QModelIndex &index, int& count) const;
     void notifyUpdated();
 
 private:
     const StatementList* mStatements;
+    const QVector<CompletionMatch>* mMatches; // rows are the first ones
+    const QVector<StatementMatchPosition>* mMatchPositions;
 };
 
 enum class CodeCompletionType {
@@ -132,8 +150,12 @@ private:
                      int line, bool onlyTypes=false);
     void addFunctionWithoutDefinitionChildren(const PStatement& scopeStatement, const QString& fileName,
                      int line);
+    // members of the class scope, including the inherited ones
+    StatementList classMembers(const PStatement& classStatement);
     void addStatement(const PStatement& statement, const QString& fileName, int line);
     void filterList(const QString& member);
+    // the completion list is changed, the next filter must check all statements
+    void resetFilter();
     void getKeywordCompletionFor(const QSet<QString>& customKeywords);
     void getCompletionFor(
             QStringList ownerExpression,
@@ -156,7 +178,7 @@ private:
                                         const QString& fileName,
                                         int line);
     void addKeyword(const QString& keyword);
-    bool isIncluded(const QString& fileName);
+    bool isIncluded(int fileId);
 private:
     CodeCompletionListView * mListView;
     CodeCompletionListModel* mModel;
@@ -164,7 +186,16 @@ private:
     //QList<PStatement> mCodeInsStatements; //temporary (user code template) statements created when show code suggestion
     StatementList mFullCompletionStatementList;
     StatementList mCompletionStatementList;
-    QSet<QString> mIncludedFiles;
+    // all matched statements of the last filter, sorted only for the listed rows
+    QVector<CompletionMatch> mMatches;
+    QVector<StatementMatchPosition> mMatchPositions;
+    QStringList mFoldedCommands; // case folded names of the full list, for ignore case matching
+    QString mFilteredPhrase;
+    bool mFilterValid;
+    bool mFilteredIgnoreCase;
+    bool mFilteredHideUnderline;
+    bool mFilteredHideTwoUnderline;
+    FileIdSet mIncludedFiles;
     QSet<QString> mUsings;
     QSet<QString> mAddedStatements;
     QString mMemberPhrase;
@@ -128,7 +128,7 @@ void NewClassCandidatesModel::fillClasses()
 {
     if (!mParser->enabled())
         return;
-    if (!mParser->freeze())
+    if (!mParser->tryFreeze())
         return;
     foreach( const PStatement& s, mParser->statementList().childrenStatements()) {
         if (s->kind==StatementKind::skClass
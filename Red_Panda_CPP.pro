@@ -21,6 +21,14 @@ APP_VERSION = 2.23
 RedPandaIDE.depends = astyle consolepauser qsynedit
 qsynedit.depends = redpanda_qt_utils
 
+# headless parser benchmark, see tools/parser-benchmark/README.md
+equals(BUILD_PARSER_BENCHMARK, "ON") {
+SUBDIRS += \
+    parser-benchmark
+parser-benchmark.subdir = tools/parser-benchmark
+parser-benchmark.depends = qsynedit redpanda_qt_utils
+}
+
 win32: {
 SUBDIRS += \
 	redpanda-win-git-askpass
@@ -16,6 +16,7 @@
  */
 #include "codefolding.h"
 #include "constants.h"
+#include <algorithm>
 
 
 namespace QSynedit {
@@ -107,6 +108,17 @@ void CodeFoldingRanges::remove(int index)
     mRanges.remove(index);
 }
 
+void CodeFoldingRanges::remove(int index, int count)
+{
+    mRanges.remove(index, count);
+}
+
+void CodeFoldingRanges::insert(int index, const QVector<PCodeFoldingRange> &ranges)
+{
+    mRanges.insert(index, ranges.count(), PCodeFoldingRange());
+    std::copy(ranges.begin(), ranges.end(), mRanges.begin()+index);
+}
+
 void CodeFoldingRanges::add(PCodeFoldingRange foldRange)
 {
     mRanges.push_back(foldRange);
@@ -122,4 +134,56 @@ const QVector<PCodeFoldingRange> &CodeFoldingRanges::ranges() const
     return mRanges;
 }
 
+CollapsedFoldSpans::CollapsedFoldSpans():
+    mHiddenLines(0)
+{
+
+}
+
+void CollapsedFoldSpans::rebuild(const CodeFoldingRanges &allFoldRanges)
+{
+    clear();
+    foreach (const PCodeFoldingRange& range, allFoldRanges.ranges()) {
+        if (!range->collapsed || range->parentCollapsed())
+            continue;
+        Span span{range->fromLine, range->toLine, range->linesCollapsed, mHiddenLines};
+        mSpans.append(span);
+        mHiddenLines += range->linesCollapsed;
+    }
+}
+
+void CollapsedFoldSpans::clear()
+{
+    mSpans.clear();
+    mHiddenLines = 0;
+}
+
+int CollapsedFoldSpans::lineToRow(int line) const
+{
+    // spans ending before the line
+    auto it = std::lower_bound(mSpans.begin(), mSpans.end(), line,
+                               [](const Span& span, int line) {
+        return span.toLine < line;
+    });
+    if (it == mSpans.end())
+        return line - mHiddenLines;
+    int result = line - it->hiddenBefore;
+    // Inside fold
+    if (it->fromLine < line)
+        result -= line - it->fromLine;
+    return result;
+}
+
+int CollapsedFoldSpans::rowToLine(int row) const
+{
+    // spans starting before the row, after the lines hidden before them are counted
+    auto it = std::lower_bound(mSpans.begin(), mSpans.end(), row,
+                               [](const Span& span, int row) {
+        return span.fromLine - span.hiddenBefore < row;
+    });
+    if (it == mSpans.end())
+        return row + mHiddenLines;
+    return row + it->hiddenBefore;
+}
+
 }
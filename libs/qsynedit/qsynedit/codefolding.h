@@ -52,6 +52,8 @@ public:
 
     void insert(int index, PCodeFoldingRange range);
     void remove(int index);
+    void remove(int index, int count);
+    void insert(int index, const QVector<PCodeFoldingRange>& ranges);
     void add(PCodeFoldingRange foldRange);
     PCodeFoldingRange operator[](int index) const;
     const QVector<PCodeFoldingRange> &ranges() const;
@@ -76,5 +78,26 @@ public:
     void move(int count);
 };
 
+// Lines hidden by collapsed folds, to convert between lines and display rows
+// by binary search. It must be rebuilt when folds are collapsed, expanded or moved.
+class CollapsedFoldSpans {
+public:
+    explicit CollapsedFoldSpans();
+    void rebuild(const CodeFoldingRanges& allFoldRanges);
+    void clear();
+    int lineToRow(int line) const;
+    int rowToLine(int row) const;
+private:
+    struct Span {
+        int fromLine;
+        int toLine;
+        int linesCollapsed;
+        int hiddenBefore; // lines hidden by the spans before it
+    };
+    // collapsed folds not inside another collapsed fold, sorted by fromLine
+    QVector<Span> mSpans;
+    int mHiddenLines;
+};
+
 }
 #endif // CODEFOLDING_H
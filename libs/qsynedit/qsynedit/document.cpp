@@ -27,6 +27,10 @@
 #include <cmath>
 #include "qt_utils/charsetinfo.h"
 #include <QDebug>
+#include <algorithm>
+
+#define DOCUMENT_TEXT_CHUNK_SIZE 256
+#define CHAR_COLUMNS_UNKNOWN 0xFF
 
 namespace QSynedit {
 
@@ -46,6 +50,9 @@ Document::Document(const QFont& font, const QFont& nonAsciiFont, QObject *parent
     mIndexOfLongestLine = -1;
     mUpdateCount = 0;
     mCharWidth =  mFontMetrics.horizontalAdvance("M");
+    resetCharColumnsCache();
+    mSnapshot = std::make_shared<DocumentText>();
+    mSnapshotOutdated = false;
 }
 
 static void listIndexOutOfBounds(int index) {
@@ -161,6 +168,7 @@ SyntaxState Document::getSyntaxState(int index)
 {
     QMutexLocker locker(&mMutex);
     if (index>=0 && index < mLines.size()) {
+        applyIndentLinesMoves(index);
         return mLines[index]->syntaxState;
     } else {
          listIndexOutOfBounds(index);
@@ -171,20 +179,24 @@ SyntaxState Document::getSyntaxState(int index)
 void Document::insertItem(int Index, const QString &s)
 {
     beginUpdate();
-    PDocumentLine line = std::make_shared<DocumentLine>();
+    PDocumentLine line = newDocumentLine();
     line->lineText = s;
     mIndexOfLongestLine = -1;
     mLines.insert(Index,line);
+    mText.insertLine(Index,s);
+    mSnapshotOutdated = true;
     endUpdate();
 }
 
 void Document::addItem(const QString &s)
 {
     beginUpdate();
-    PDocumentLine line = std::make_shared<DocumentLine>();
+    PDocumentLine line = newDocumentLine();
     line->lineText = s;
     mIndexOfLongestLine = -1;
     mLines.append(line);
+    mText.insertLine(mText.count(),s);
+    mSnapshotOutdated = true;
     endUpdate();
 }
 
@@ -208,9 +220,68 @@ void Document::setSyntaxState(int Index, const SyntaxState& range)
     }
     //beginUpdate();
     mLines[Index]->syntaxState = range;
+    mLines[Index]->indentLinesMoves = mIndentLinesMoves.count();
     //endUpdate();
 }
 
+static int movedIndentLine(int indentLine, int line, int delta)
+{
+    if (indentLine < line)
+        return indentLine;
+    // the line is deleted
+    if (delta < 0 && indentLine < line - delta)
+        return line;
+    return indentLine + delta;
+}
+
+void Document::moveIndentLines(int fromIndex, int line, int delta)
+{
+    QMutexLocker locker(&mMutex);
+    if (delta == 0)
+        return;
+    mIndentLinesMoves.append(IndentLinesMove{std::max(fromIndex,0), line, delta});
+}
+
+PDocumentLine Document::newDocumentLine() const
+{
+    PDocumentLine line = std::make_shared<DocumentLine>();
+    // moves before the line exists don't apply to it
+    line->indentLinesMoves = mIndentLinesMoves.count();
+    return line;
+}
+
+void Document::applyIndentLinesMoves(int index)
+{
+    DocumentLine& documentLine = *mLines[index];
+    int first = documentLine.indentLinesMoves;
+    int last = mIndentLinesMoves.count()-1;
+    if (first > last)
+        return;
+    // find the moves applying to the line from where it was after each of them
+    QVector<bool> applied(last-first+1);
+    int pos = index;
+    for (int k=last;k>=first;k--) {
+        const IndentLinesMove& move = mIndentLinesMoves[k];
+        if (pos < move.fromIndex)
+            continue;
+        applied[k-first] = true;
+        pos -= move.delta;
+    }
+    SyntaxState& state = documentLine.syntaxState;
+    for (int k=first;k<=last;k++) {
+        if (!applied[k-first])
+            continue;
+        const IndentLinesMove& move = mIndentLinesMoves[k];
+        // lastUnindent at line 0 is also used for unmatched unindents, leave it as is
+        if (state.lastUnindent.line > 0)
+            state.lastUnindent.line = movedIndentLine(state.lastUnindent.line, move.line, move.delta);
+        for (int j=0;j<state.indents.count();j++) {
+            state.indents[j].line = movedIndentLine(state.indents[j].line, move.line, move.delta);
+        }
+    }
+    documentLine.indentLinesMoves = mIndentLinesMoves.count();
+}
+
 QString Document::getLine(int Index)
 {
     QMutexLocker locker(&mMutex);
@@ -268,6 +339,12 @@ QStringList Document::contents()
     return result;
 }
 
+PDocumentText Document::snapshot()
+{
+    QMutexLocker locker(&mSnapshotMutex);
+    return mSnapshot;
+}
+
 void Document::beginUpdate()
 {
     if (mUpdateCount == 0) {
@@ -280,6 +357,7 @@ void Document::endUpdate()
 {
     mUpdateCount--;
     if (mUpdateCount == 0) {
+        publishSnapshot();
         setUpdateState(false);
     }
 }
@@ -359,6 +437,8 @@ void Document::deleteLines(int index, int numLines)
        numLines = mLines.count() - index;
     }
     mLines.remove(index,numLines);
+    mText.deleteLines(index,numLines);
+    mSnapshotOutdated = true;
     emit deleted(index,numLines);
 }
 
@@ -375,6 +455,9 @@ void Document::exchange(int index1, int index2)
     PDocumentLine temp = mLines[index1];
     mLines[index1]=mLines[index2];
     mLines[index2]=temp;
+    mText.putLine(index1,mLines[index1]->lineText);
+    mText.putLine(index2,mLines[index2]->lineText);
+    mSnapshotOutdated = true;
     //mList.swapItemsAt(Index1,Index2);
     if (mIndexOfLongestLine == index1) {
         mIndexOfLongestLine = index2;
@@ -408,6 +491,8 @@ void Document::deleteAt(int index)
     else if (mIndexOfLongestLine>index)
         mIndexOfLongestLine -= 1;
     mLines.removeAt(index);
+    mText.deleteLines(index,1);
+    mSnapshotOutdated = true;
     emit deleted(index,1);
     endUpdate();
 }
@@ -437,6 +522,8 @@ void Document::putLine(int index, const QString &s, bool notify) {
         beginUpdate();
         int oldColumns = mLines[index]->columns;
         mLines[index]->lineText = s;
+        mText.putLine(index,s);
+        mSnapshotOutdated = true;
         calculateLineColumns(index);
         if (mIndexOfLongestLine == index && oldColumns>mLines[index]->columns )
             mIndexOfLongestLine = -1;
@@ -482,9 +569,15 @@ void Document::insertLines(int index, int numLines)
     PDocumentLine line;
     mLines.insert(index,numLines,line);
     for (int i=index;i<index+numLines;i++) {
-        line = std::make_shared<DocumentLine>();
+        line = newDocumentLine();
         mLines[i]=line;
     }
+    QStringList emptyLines;
+    emptyLines.reserve(numLines);
+    for (int i=0;i<numLines;i++)
+        emptyLines.append(QString());
+    mText.insertLines(index,emptyLines);
+    mSnapshotOutdated = true;
     emit inserted(index,numLines);
 }
 
@@ -546,6 +639,17 @@ void Document::loadUTF32BOMFile(QFile &file)
     this->setText(text);
 }
 
+void Document::publishSnapshot()
+{
+    if (!mSnapshotOutdated)
+        return;
+    // copying only shares the chunks, the next change copies the chunk it touches
+    PDocumentText snapshot = std::make_shared<DocumentText>(mText);
+    QMutexLocker locker(&mSnapshotMutex);
+    mSnapshot.swap(snapshot);
+    mSnapshotOutdated = false;
+}
+
 void Document::saveUTF16File(QFile &file, QTextCodec* codec)
 {
     if (!codec)
@@ -572,6 +676,7 @@ void Document::setFontMetrics(const QFont &newFont, const QFont& newNonAsciiFont
     mFontMetrics = QFontMetrics(newFont);
     mCharWidth =  mFontMetrics.horizontalAdvance("M");
     mNonAsciiFontMetrics = QFontMetrics(newNonAsciiFont);
+    resetCharColumnsCache();
 }
 
 void Document::setTabWidth(int newTabWidth)
@@ -790,6 +895,26 @@ void Document::saveToFile(QFile &file, const QByteArray& encoding,
 int Document::stringColumns(const QString &line, int colsBefore) const
 {
     int columns = std::max(0,colsBefore);
+    const ushort* chars = line.utf16();
+    int length = line.length();
+    if (mAsciiMonospaced) {
+        ushort bits = 0;
+        for (int i=0;i<length;i++)
+            bits |= chars[i];
+        if (bits < 0x80) {
+            // every char takes one column, except tabs
+            int start = 0;
+            for (int i=0;i<length;i++) {
+                if (chars[i] == '\t') {
+                    columns += i - start;
+                    columns += mTabWidth - columns % mTabWidth;
+                    start = i+1;
+                }
+            }
+            columns += length - start;
+            return columns-colsBefore;
+        }
+    }
     int charCols;
     for (int i=0;i<line.length();i++) {
         QChar ch = line[i];
@@ -807,13 +932,38 @@ int Document::charColumns(QChar ch) const
 {
     if (ch.unicode()<=32)
         return 1;
+    if (mCharColumnsCache.isEmpty())
+        mCharColumnsCache.fill(CHAR_COLUMNS_UNKNOWN, 0x10000);
+    int columns = mCharColumnsCache[ch.unicode()];
+    if (columns == CHAR_COLUMNS_UNKNOWN) {
+        columns = measureCharColumns(ch);
+        mCharColumnsCache[ch.unicode()] = columns;
+    }
+    return columns;
+}
+
+int Document::measureCharColumns(QChar ch) const
+{
     int width;
     if (ch.unicode()<0xFF)
         width = mFontMetrics.horizontalAdvance(ch);
     else
         width = mNonAsciiFontMetrics.horizontalAdvance(ch);
     //return std::ceil((int)(fontMetrics().horizontalAdvance(ch) * dpiFactor()) / (double)mCharWidth);
-    return std::ceil(width / (double)mCharWidth);
+    return std::min((int)std::ceil(width / (double)mCharWidth), CHAR_COLUMNS_UNKNOWN-1);
+}
+
+void Document::resetCharColumnsCache()
+{
+    // filled again when a char is used
+    mCharColumnsCache.clear();
+    mAsciiMonospaced = true;
+    for (ushort ch=33;ch<0x80;ch++) {
+        if (measureCharColumns(QChar(ch))!=1) {
+            mAsciiMonospaced = false;
+            break;
+        }
+    }
 }
 
 void Document::putTextStr(const QString &text)
@@ -850,6 +1000,9 @@ void Document::internalClear()
         int oldCount = mLines.count();
         mIndexOfLongestLine = -1;
         mLines.clear();
+        mIndentLinesMoves.clear();
+        mText.clear();
+        mSnapshotOutdated = true;
         emit deleted(0,oldCount);
         endUpdate();
     }
@@ -893,10 +1046,153 @@ void Document::invalidAllLineColumns()
     }
 }
 
+DocumentText::DocumentText():
+    mCount(0)
+{
+}
+
+QString DocumentText::line(int index) const
+{
+    if (index<0 || index>=mCount)
+        return QString();
+    int chunk = findChunk(index);
+    return mChunks.at(chunk).at(index - mChunkStarts.at(chunk));
+}
+
+QStringList DocumentText::toList() const
+{
+    QStringList result;
+    result.reserve(mCount);
+    foreach (const QStringList& chunk, mChunks) {
+        result.append(chunk);
+    }
+    return result;
+}
+
+void DocumentText::insertLine(int index, const QString &s)
+{
+    if (mChunks.isEmpty()) {
+        mChunks.append(QStringList());
+        mChunkStarts.append(0);
+    }
+    int chunk = (index>=mCount) ? mChunks.count()-1 : findChunk(index);
+    mChunks[chunk].insert(index - mChunkStarts.at(chunk), s);
+    mCount++;
+    if (mChunks.at(chunk).count() > 2*DOCUMENT_TEXT_CHUNK_SIZE)
+        splitChunk(chunk);
+    else
+        updateChunkStarts(chunk+1);
+}
+
+void DocumentText::insertLines(int index, const QStringList &lines)
+{
+    if (lines.isEmpty())
+        return;
+    if (mChunks.isEmpty()) {
+        mChunks.append(QStringList());
+        mChunkStarts.append(0);
+    }
+    int chunk = (index>=mCount) ? mChunks.count()-1 : findChunk(index);
+    QStringList& chunkLines = mChunks[chunk];
+    int pos = index - mChunkStarts.at(chunk);
+    chunkLines = chunkLines.mid(0,pos) + lines + chunkLines.mid(pos);
+    mCount += lines.count();
+    if (chunkLines.count() > 2*DOCUMENT_TEXT_CHUNK_SIZE)
+        splitChunk(chunk);
+    else
+        updateChunkStarts(chunk+1);
+}
+
+void DocumentText::deleteLines(int index, int numLines)
+{
+    if (index<0 || index>=mCount || numLines<=0)
+        return;
+    numLines = std::min(numLines, mCount-index);
+    int first = findChunk(index);
+    int chunk = first;
+    int pos = index - mChunkStarts.at(chunk);
+    int remaining = numLines;
+    while (remaining>0) {
+        int n = std::min(remaining, mChunks.at(chunk).count() - pos);
+        if (n == mChunks.at(chunk).count()) {
+            mChunks.remove(chunk);
+            mChunkStarts.remove(chunk);
+        } else {
+            QStringList& chunkLines = mChunks[chunk];
+            chunkLines.erase(chunkLines.begin()+pos, chunkLines.begin()+pos+n);
+            chunk++;
+        }
+        remaining -= n;
+        pos = 0;
+    }
+    mCount -= numLines;
+    // don't let small chunks pile up around the deleted range
+    if (first+1<mChunks.count())
+        mergeChunks(first);
+    if (first>0 && first<mChunks.count())
+        mergeChunks(first-1);
+    updateChunkStarts(std::max(first-1,0));
+}
+
+void DocumentText::putLine(int index, const QString &s)
+{
+    if (index<0 || index>=mCount)
+        return;
+    int chunk = findChunk(index);
+    mChunks[chunk][index - mChunkStarts.at(chunk)] = s;
+}
+
+void DocumentText::clear()
+{
+    mChunks.clear();
+    mChunkStarts.clear();
+    mCount = 0;
+}
+
+int DocumentText::findChunk(int index) const
+{
+    // the last chunk starting at or before index
+    auto it = std::upper_bound(mChunkStarts.constBegin(), mChunkStarts.constEnd(), index);
+    return (it - mChunkStarts.constBegin()) - 1;
+}
+
+void DocumentText::splitChunk(int chunk)
+{
+    QStringList lines = mChunks.at(chunk);
+    int pieces = (lines.count() + DOCUMENT_TEXT_CHUNK_SIZE - 1) / DOCUMENT_TEXT_CHUNK_SIZE;
+    mChunks[chunk] = lines.mid(0, DOCUMENT_TEXT_CHUNK_SIZE);
+    mChunks.insert(chunk+1, pieces-1, QStringList());
+    mChunkStarts.insert(chunk+1, pieces-1, 0);
+    for (int i=1;i<pieces;i++) {
+        mChunks[chunk+i] = lines.mid(i*DOCUMENT_TEXT_CHUNK_SIZE, DOCUMENT_TEXT_CHUNK_SIZE);
+    }
+    updateChunkStarts(chunk+1);
+}
+
+void DocumentText::mergeChunks(int chunk)
+{
+    if (mChunks.at(chunk).count() + mChunks.at(chunk+1).count() > DOCUMENT_TEXT_CHUNK_SIZE)
+        return;
+    mChunks[chunk].append(mChunks.at(chunk+1));
+    mChunks.remove(chunk+1);
+    mChunkStarts.remove(chunk+1);
+}
+
+void DocumentText::updateChunkStarts(int fromChunk)
+{
+    if (mChunkStarts.isEmpty())
+        return;
+    mChunkStarts[0] = 0;
+    for (int i=std::max(fromChunk,1);i<mChunks.count();i++) {
+        mChunkStarts[i] = mChunkStarts.at(i-1) + mChunks.at(i-1).count();
+    }
+}
+
 DocumentLine::DocumentLine():
     lineText(),
     syntaxState(),
-    columns(-1)
+    columns(-1),
+    indentLinesMoves(0)
 {
 }
 
@@ -34,6 +34,7 @@ struct DocumentLine {
   QString lineText;
   SyntaxState syntaxState;
   int columns;  //
+  int indentLinesMoves; // count of Document's indent line moves already applied to syntaxState
 public:
   explicit DocumentLine();
   DocumentLine(const DocumentLine&)=delete;
@@ -46,6 +47,40 @@ typedef QVector<PDocumentLine> DocumentLines;
 
 typedef std::shared_ptr<DocumentLines> PDocumentLines;
 
+/**
+ * Text of the document, kept as a list of chunks of lines.
+ *
+ * Copies are cheap: they share the chunks, and a chunk is copied only when
+ * it's changed while shared. So a copy can be handed to other threads as a
+ * read-only snapshot of the document.
+ */
+class DocumentText {
+public:
+    explicit DocumentText();
+    int count() const {
+        return mCount;
+    }
+    QString line(int index) const;
+    QStringList toList() const;
+
+    void insertLine(int index, const QString& s);
+    void insertLines(int index, const QStringList& lines);
+    void deleteLines(int index, int numLines);
+    void putLine(int index, const QString& s);
+    void clear();
+private:
+    int findChunk(int index) const;
+    void splitChunk(int chunk);
+    void mergeChunks(int chunk);
+    void updateChunkStarts(int fromChunk);
+private:
+    QVector<QStringList> mChunks;
+    QVector<int> mChunkStarts; // index of the first line in each chunk
+    int mCount;
+};
+
+typedef std::shared_ptr<const DocumentText> PDocumentText;
+
 class Document;
 
 typedef std::shared_ptr<Document> PDocument;
@@ -69,12 +104,18 @@ public:
     QString lineBreak() const;
     SyntaxState getSyntaxState(int index);
     void setSyntaxState(int index, const SyntaxState& range);
+    // indents in syntax states keep the (absolute) lines they start at,
+    // move them with the lines when lines before them are inserted or deleted.
+    // It's only recorded here, the states are moved when they are read.
+    void moveIndentLines(int fromIndex, int line, int delta);
     QString getLine(int index);
     int count();
     QString text();
     void setText(const QString& text);
     void setContents(const QStringList& text);
     QStringList contents();
+    // text at the end of the last change, can be read from any thread without locking the document
+    PDocumentText snapshot();
 
     void putLine(int index, const QString& s, bool notify=true);
 
@@ -138,9 +179,25 @@ private:
     void loadUTF32BOMFile(QFile& file);
     void saveUTF16File(QFile& file, QTextCodec* codec);
     void saveUTF32File(QFile& file, QTextCodec* codec);
+    void publishSnapshot();
+    PDocumentLine newDocumentLine() const;
+    void applyIndentLinesMoves(int index);
+    int measureCharColumns(QChar ch) const;
+    void resetCharColumnsCache();
 
 private:
+    struct IndentLinesMove {
+        int fromIndex; // states of the lines from it (after the move) are moved
+        int line;
+        int delta;
+    };
     DocumentLines mLines;
+    // moves of indent lines since the document is cleared
+    QVector<IndentLinesMove> mIndentLinesMoves;
+    DocumentText mText;
+    PDocumentText mSnapshot;
+    bool mSnapshotOutdated;
+    QMutex mSnapshotMutex;
 
     //SynEdit* mEdit;
 
@@ -148,6 +205,10 @@ private:
     QFontMetrics mNonAsciiFontMetrics;
     int mTabWidth;
     int mCharWidth;
+    // columns of each utf-16 char, measured when it's first used
+    mutable QVector<quint8> mCharColumnsCache;
+    // all printable ascii chars take one column, so pure ascii lines don't need the font
+    bool mAsciiMonospaced;
     //int mCount;
     //int mCapacity;
     NewlineType mNewlineType;
@@ -24,6 +24,8 @@
 #include <QPaintEvent>
 #include <QPainter>
 #include <QTimerEvent>
+#include <QElapsedTimer>
+#include <QSet>
 #include "syntaxer/syntaxer.h"
 #include "constants.h"
 #include "painter.h"
@@ -41,6 +43,11 @@
 #include <QTextEdit>
 #include <QMimeData>
 
+// the background syntax scan returns to the event loop after running the time (in milliseconds)
+#define SYNTAX_SCAN_TIME_SLICE 10
+// and checks the time every SYNTAX_SCAN_CHECK_LINES lines
+#define SYNTAX_SCAN_CHECK_LINES 64
+
 namespace QSynedit {
 QSynEdit::QSynEdit(QWidget *parent) : QAbstractScrollArea(parent),
     mEditingCount{0},
@@ -145,6 +152,16 @@ QSynEdit::QSynEdit(QWidget *parent) : QAbstractScrollArea(parent),
     //mScrollTimer->setInterval(100);
     connect(mScrollTimer, &QTimer::timeout,this, &QSynEdit::onScrollTimeout);
 
+    mSyntaxScanTimer = new QTimer(this);
+    mSyntaxScanTimer->setSingleShot(true);
+    mSyntaxScanTimer->setInterval(0);
+    connect(mSyntaxScanTimer, &QTimer::timeout,this, &QSynEdit::onSyntaxScanTimeout);
+    mSyntaxScanLine = -1;
+    mSyntaxScanEditedLine = -1;
+    mSyntaxScanFoldLine = -1;
+    mEditingFirstLine = -1;
+    mEditingLastLine = -1;
+
     qreal dpr=devicePixelRatioF();
     mContentImage = std::make_shared<QImage>(clientWidth()*dpr,clientHeight()*dpr,QImage::Format_ARGB32);
     mContentImage->setDevicePixelRatio(dpr);
@@ -924,31 +941,12 @@ int QSynEdit::lineToRow(int aLine) const
 
 int QSynEdit::foldRowToLine(int Row) const
 {
-    int result = Row;
-    for (int i=0;i<mAllFoldRanges->count();i++) {
-        PCodeFoldingRange range = (*mAllFoldRanges)[i];
-        if (range->collapsed && !range->parentCollapsed() && range->fromLine < result) {
-            result += range->linesCollapsed;
-        }
-    }
-    return result;
+    return mCollapsedFoldSpans.rowToLine(Row);
 }
 
 int QSynEdit::foldLineToRow(int Line) const
 {
-    int result = Line;
-    for (int i=mAllFoldRanges->count()-1;i>=0;i--) {
-        PCodeFoldingRange range =(*mAllFoldRanges)[i];
-        if (range->collapsed && !range->parentCollapsed()) {
-            // Line is found after fold
-            if (range->toLine < Line)
-                result -= range->linesCollapsed;
-            // Inside fold
-            else if (range->fromLine < Line && Line <= range->toLine)
-                result -= Line - range->fromLine;
-        }
-    }
-    return result;
+    return mCollapsedFoldSpans.lineToRow(Line);
 }
 
 void QSynEdit::setDefaultKeystrokes()
@@ -1203,8 +1201,20 @@ void QSynEdit::collapseAll()
 {
     incPaintLock();
     for (int i = mAllFoldRanges->count()-1;i>=0;i--){
-        collapse((*mAllFoldRanges)[i]);
+        collapseWithoutRebuild((*mAllFoldRanges)[i]);
     }
+    mCollapsedFoldSpans.rebuild(*mAllFoldRanges);
+    // extract caret from the outermost fold hiding it
+    PCodeFoldingRange outerMost;
+    for (int i = 0;i<mAllFoldRanges->count();i++){
+        PCodeFoldingRange range = (*mAllFoldRanges)[i];
+        if ((mCaretY > range->fromLine) && (mCaretY <= range->toLine)
+                && (!outerMost || range->fromLine < outerMost->fromLine))
+            outerMost = range;
+    }
+    if (outerMost)
+        extractCaretFromFold(outerMost);
+    updateScrollbars();
     decPaintLock();
 }
 
@@ -1212,8 +1222,10 @@ void QSynEdit::unCollpaseAll()
 {
     incPaintLock();
     for (int i = mAllFoldRanges->count()-1;i>=0;i--){
-        uncollapse((*mAllFoldRanges)[i]);
+        uncollapseWithoutRebuild((*mAllFoldRanges)[i]);
     }
+    mCollapsedFoldSpans.rebuild(*mAllFoldRanges);
+    updateScrollbars();
     decPaintLock();
 }
 
@@ -1819,7 +1831,7 @@ void QSynEdit::endEditing()
     if (mEditingCount==0) {
         if (!mUndoing)
             mUndoList->endBlock();
-        reparseDocument();
+        scanEditedLines();
     }
     decPaintLock();
 }
@@ -3271,31 +3283,157 @@ void QSynEdit::updateModifiedStatus()
         emit statusChanged(StatusChange::scModifyChanged);
 }
 
-void QSynEdit::scanFrom(int index)
+void QSynEdit::scanFrom(int index, int lastEditedIndex)
 {
-    if (mEditingCount>0)
+    if (mEditingCount>0) {
+        if (mEditingFirstLine<0) {
+            mEditingFirstLine = index;
+            mEditingLastLine = lastEditedIndex;
+        } else {
+            mEditingFirstLine = std::min(mEditingFirstLine, index);
+            mEditingLastLine = std::max(mEditingLastLine, lastEditedIndex);
+        }
         return;
+    }
 
-    SyntaxState state;
     int idx = std::max(0,index);
     if (idx >= mDocument->count())
         return;
+    int firstIndex = idx;
+    lastEditedIndex = std::min(std::max(idx,lastEditedIndex), mDocument->count()-1);
+    // states from it are out of date, leave them to the background scan
+    if (mSyntaxScanLine>=0 && idx >= mSyntaxScanLine) {
+        mSyntaxScanEditedLine = std::max(mSyntaxScanEditedLine, lastEditedIndex);
+        return;
+    }
+    // lines in the window are painted with the new states right away
+    int lastSyncIndex = std::max(lastEditedIndex, rowToLine(mTopLine+mLinesInWindow));
 
     if (idx == 0) {
         mSyntaxer->resetState();
     } else {
         mSyntaxer->setState(mDocument->getSyntaxState(idx-1));
     }
-    do {
-        mSyntaxer->setLine(mDocument->getLine(idx), idx);
-        mSyntaxer->nextToEol();
-        state = mSyntaxer->getState();
-        mDocument->setSyntaxState(idx,state);
-        idx ++ ;
-    } while (idx < mDocument->count());
-    if (mUseCodeFolding)
-        rescanFolds();
-    return ;
+    bool foldChanged = false;
+    while (idx < mDocument->count()) {
+        bool unchanged = rescanLineState(idx, foldChanged);
+        // the following lines would get the same states as before
+        if (unchanged && idx > lastEditedIndex)
+            break;
+        idx++;
+        if (idx == mSyntaxScanLine) {
+            mSyntaxScanEditedLine = std::max(mSyntaxScanEditedLine, lastEditedIndex);
+            break;
+        }
+        if (idx > lastSyncIndex && idx < mDocument->count()) {
+            startBackgroundSyntaxScan(idx, lastEditedIndex);
+            break;
+        }
+    }
+    if (foldChanged)
+        markFoldRangesChanged(firstIndex);
+    if (mSyntaxScanLine<0 && mSyntaxScanFoldLine>=0) {
+        int foldLine = mSyntaxScanFoldLine;
+        mSyntaxScanFoldLine = -1;
+        updateFoldRanges(foldLine, idx);
+    }
+}
+
+void QSynEdit::scanEditedLines()
+{
+    if (mEditingFirstLine>=0) {
+        int firstIndex = mEditingFirstLine;
+        int lastIndex = mEditingLastLine;
+        mEditingFirstLine = -1;
+        mEditingLastLine = -1;
+        if (mSyntaxer && mDocument->count() > 0)
+            scanFrom(std::min(firstIndex, mDocument->count()-1), lastIndex);
+    }
+    // the background scan is paused while editing
+    if (mSyntaxScanLine>=0 && !mSyntaxScanTimer->isActive())
+        mSyntaxScanTimer->start();
+}
+
+bool QSynEdit::rescanLineState(int index, bool &foldChanged)
+{
+    mSyntaxer->setLine(mDocument->getLine(index), index);
+    mSyntaxer->nextToEol();
+    SyntaxState state = mSyntaxer->getState();
+    SyntaxState oldState = mDocument->getSyntaxState(index);
+    // fields not compared (like hasTrailingSpaces) may still be changed
+    mDocument->setSyntaxState(index,state);
+    if (state == oldState)
+        return true;
+    if (state.blockStarted != oldState.blockStarted
+            || state.blockEnded != oldState.blockEnded)
+        foldChanged = true;
+    return false;
+}
+
+void QSynEdit::startBackgroundSyntaxScan(int index, int lastEditedIndex)
+{
+    // lines between index and the old scan line keep the states scanned from the old contents
+    if (mSyntaxScanLine<0)
+        mSyntaxScanEditedLine = lastEditedIndex;
+    else
+        mSyntaxScanEditedLine = std::max(mSyntaxScanEditedLine, lastEditedIndex);
+    mSyntaxScanLine = index;
+    mSyntaxScanTimer->start();
+}
+
+void QSynEdit::cancelBackgroundSyntaxScan()
+{
+    mSyntaxScanTimer->stop();
+    mSyntaxScanLine = -1;
+    mSyntaxScanEditedLine = -1;
+    mSyntaxScanFoldLine = -1;
+}
+
+void QSynEdit::onSyntaxScanTimeout()
+{
+    if (mSyntaxScanLine<0 || !mSyntaxer)
+        return;
+    // lines are changing, scanEditedLines() resumes the scan when editing ends
+    if (mEditingCount>0)
+        return;
+    int idx = mSyntaxScanLine;
+    int firstIndex = idx;
+    bool done = (idx >= mDocument->count());
+    bool foldChanged = false;
+    if (!done) {
+        if (idx == 0) {
+            mSyntaxer->resetState();
+        } else {
+            mSyntaxer->setState(mDocument->getSyntaxState(idx-1));
+        }
+        QElapsedTimer timer;
+        timer.start();
+        while (idx < mDocument->count()) {
+            bool unchanged = rescanLineState(idx, foldChanged);
+            if (unchanged && idx > mSyntaxScanEditedLine) {
+                done = true;
+                break;
+            }
+            idx++;
+            if ((idx-firstIndex) % SYNTAX_SCAN_CHECK_LINES == 0
+                    && timer.elapsed() >= SYNTAX_SCAN_TIME_SLICE)
+                break;
+        }
+        if (idx >= mDocument->count())
+            done = true;
+        invalidateLines(firstIndex+1, idx+1);
+    }
+    if (foldChanged)
+        markFoldRangesChanged(firstIndex);
+    if (done) {
+        int foldLine = mSyntaxScanFoldLine;
+        cancelBackgroundSyntaxScan();
+        if (foldLine>=0)
+            updateFoldRanges(foldLine, idx);
+    } else {
+        mSyntaxScanLine = idx;
+        mSyntaxScanTimer->start();
+    }
 }
 
 void QSynEdit::reparseLine(int line)
@@ -3320,6 +3458,9 @@ void QSynEdit::reparseLine(int line)
 
 void QSynEdit::reparseDocument()
 {
+    cancelBackgroundSyntaxScan();
+    mEditingFirstLine = -1;
+    mEditingLastLine = -1;
     if (mSyntaxer && !mDocument->empty()) {
 //        qint64 begin=QDateTime::currentMSecsSinceEpoch();
         mSyntaxer->resetState();
@@ -3337,6 +3478,13 @@ void QSynEdit::reparseDocument()
 }
 
 void QSynEdit::uncollapse(PCodeFoldingRange FoldRange)
+{
+    uncollapseWithoutRebuild(FoldRange);
+    mCollapsedFoldSpans.rebuild(*mAllFoldRanges);
+    updateScrollbars();
+}
+
+void QSynEdit::uncollapseWithoutRebuild(PCodeFoldingRange FoldRange)
 {
     FoldRange->linesCollapsed = 0;
     FoldRange->collapsed = false;
@@ -3346,62 +3494,124 @@ void QSynEdit::uncollapse(PCodeFoldingRange FoldRange)
 
     // Redraw fold mark
     invalidateGutterLines(FoldRange->fromLine, INT_MAX);
-    updateScrollbars();
 }
 
 void QSynEdit::collapse(PCodeFoldingRange FoldRange)
+{
+    collapseWithoutRebuild(FoldRange);
+    mCollapsedFoldSpans.rebuild(*mAllFoldRanges);
+    extractCaretFromFold(FoldRange);
+    updateScrollbars();
+}
+
+void QSynEdit::collapseWithoutRebuild(PCodeFoldingRange FoldRange)
 {
     FoldRange->linesCollapsed = FoldRange->toLine - FoldRange->fromLine;
     FoldRange->collapsed = true;
 
-    // Extract caret from fold
-    if ((mCaretY > FoldRange->fromLine) && (mCaretY <= FoldRange->toLine)) {
-          setCaretXY(BufferCoord{mDocument->getLine(FoldRange->fromLine - 1).length() + 1,
-                                 FoldRange->fromLine});
-    }
-
     // Redraw the collapsed line
     invalidateLines(FoldRange->fromLine, INT_MAX);
 
     // Redraw fold mark
     invalidateGutterLines(FoldRange->fromLine, INT_MAX);
+}
 
-    updateScrollbars();
+void QSynEdit::extractCaretFromFold(PCodeFoldingRange FoldRange)
+{
+    if ((mCaretY > FoldRange->fromLine) && (mCaretY <= FoldRange->toLine)) {
+          setCaretXY(BufferCoord{mDocument->getLine(FoldRange->fromLine - 1).length() + 1,
+                                 FoldRange->fromLine});
+    }
 }
 
 void QSynEdit::foldOnListInserted(int Line, int Count)
 {
-    // Delete collapsed inside selection
+    bool uncollapsed = false;
     for (int i = mAllFoldRanges->count()-1;i>=0;i--) {
         PCodeFoldingRange range = (*mAllFoldRanges)[i];
-        if (range->fromLine == Line - 1) {// insertion starts at fold line
-            if (range->collapsed)
-                uncollapse(range);
-        } else if (range->fromLine >= Line) // insertion of count lines above FromLine
+        if (range->fromLine >= Line) { // insertion of count lines above FromLine
             range->move(Count);
+            continue;
+        }
+        if (range->fromLine == Line - 1) {// insertion starts at fold line
+            if (range->collapsed) {
+                uncollapseWithoutRebuild(range);
+                uncollapsed = true;
+            }
+        }
+        if (range->toLine >= Line) { // insertion inside the fold
+            if (range->collapsed) {
+                uncollapseWithoutRebuild(range);
+                uncollapsed = true;
+            }
+            range->toLine += Count;
+        }
     }
+    mCollapsedFoldSpans.rebuild(*mAllFoldRanges);
+    if (uncollapsed)
+        updateScrollbars();
 }
 
 void QSynEdit::foldOnListDeleted(int Line, int Count)
 {
-    // Delete collapsed inside selection
+    bool uncollapsed = false;
     for (int i = mAllFoldRanges->count()-1;i>=0;i--) {
         PCodeFoldingRange range = (*mAllFoldRanges)[i];
-        if (range->fromLine == Line && Count == 1)  {// open up because we are messing with the starting line
-            if (range->collapsed)
-                uncollapse(range);
-        } else if (range->fromLine >= Line - 1 && range->fromLine < Line + Count) // delete inside affectec area
-            mAllFoldRanges->remove(i);
-        else if (range->fromLine >= Line + Count) // Move after affected area
+        if (range->fromLine >= Line + Count) { // Move after affected area
             range->move(-Count);
-
+        } else if (range->fromLine >= Line) { // delete inside affected area
+            if (range->collapsed) {
+                uncollapseWithoutRebuild(range);
+                uncollapsed = true;
+            }
+            PCodeFoldingRange parent = range->parent.lock();
+            // its closing line is kept and closes a parent instead
+            if (range->toLine >= Line + Count - 1 || range->toLine == range->fromLine) {
+                PCodeFoldingRange ancestor = parent;
+                while (ancestor) {
+                    if (ancestor->collapsed) {
+                        uncollapseWithoutRebuild(ancestor);
+                        uncollapsed = true;
+                    }
+                    ancestor->toLine = ancestor->fromLine;
+                    ancestor = ancestor->parent.lock();
+                }
+            }
+            // sub folds after the deleted lines are moved to the parent
+            PCodeFoldingRanges siblings;
+            int index = -1;
+            if (parent) {
+                siblings = parent->subFoldRanges;
+                index = siblings->ranges().indexOf(range);
+                if (index>=0)
+                    siblings->remove(index);
+            }
+            foreach (const PCodeFoldingRange& subRange, range->subFoldRanges->ranges()) {
+                subRange->parent = parent;
+                if (index>=0)
+                    siblings->insert(index++, subRange);
+            }
+            mAllFoldRanges->remove(i);
+        } else if (range->toLine >= Line) { // deletion inside the fold
+            if (range->collapsed) {
+                uncollapseWithoutRebuild(range);
+                uncollapsed = true;
+            }
+            if (range->toLine >= Line + Count)
+                range->toLine -= Count;
+            else // the closing line is deleted, it must be scanned again
+                range->toLine = range->fromLine;
+        }
     }
-
+    mCollapsedFoldSpans.rebuild(*mAllFoldRanges);
+    if (uncollapsed)
+        updateScrollbars();
 }
 
 void QSynEdit::foldOnListCleared()
 {
     mAllFoldRanges->clear();
+    mCollapsedFoldSpans.clear();
 }
 
 void QSynEdit::rescanFolds()
@@ -3419,53 +3629,221 @@ void QSynEdit::rescanFolds()
 
 void QSynEdit::rescanForFoldRanges()
 {
-    // Delete all uncollapsed folds
-//    for (int i=mAllFoldRanges.count()-1;i>=0;i--) {
-//        PSynEditFoldRange range =mAllFoldRanges[i];
-//        if (!range->collapsed && !range->parentCollapsed())
-//            mAllFoldRanges.remove(i);
-//    }
+    updateFoldRanges(0, mDocument->count()-1);
+}
+
+struct FoldRangeUpdate {
+    PCodeFoldingRange range; // the fold in the tree, or a new one
+    int toLine;
+    int parent; // index of the parent in the update list, -1 if it's at top level
+    bool created;
+};
 
-    // Did we leave any collapsed folds and are we viewing a code file?
-    if (mAllFoldRanges->count() > 0) {
-        QMap<QString,PCodeFoldingRange> rangeIndexes;
-        foreach(const PCodeFoldingRange& r, mAllFoldRanges->ranges()) {
-            if (r->collapsed)
-                rangeIndexes.insert(QString("%1-%2").arg(r->fromLine).arg(r->toLine),r);
-        }
-        mAllFoldRanges->clear();
-        // Add folds to a separate list
-        PCodeFoldingRanges temporaryAllFoldRanges = std::make_shared<CodeFoldingRanges>();
-        scanForFoldRanges(temporaryAllFoldRanges);
-
-        PCodeFoldingRange tempFoldRange;
-        PCodeFoldingRange r2;
-        // Combine new with old folds, preserve parent order
-        for (int i = 0; i< temporaryAllFoldRanges->count();i++) {
-            tempFoldRange=temporaryAllFoldRanges->range(i);
-            r2=rangeIndexes.value(QString("%1-%2").arg(tempFoldRange->fromLine).arg(tempFoldRange->toLine),
-                                  PCodeFoldingRange());
-            if (r2) {
-                tempFoldRange->collapsed=true;
-                tempFoldRange->linesCollapsed=r2->linesCollapsed;
+// index of the first fold starting at or after the line, ranges are sorted by fromLine
+static int lowerFoldIndex(const PCodeFoldingRanges& ranges, int line)
+{
+    const QVector<PCodeFoldingRange>& list = ranges->ranges();
+    return int(std::lower_bound(list.begin(), list.end(), line,
+                                [](const PCodeFoldingRange& range, int line) {
+        return range->fromLine < line;
+    }) - list.begin());
+}
+
+// the last sub fold of parent (or top level fold if parent is null) starting at or before the line
+static PCodeFoldingRange lastSubFoldAt(const PCodeFoldingRanges& allFoldRanges,
+                                       const PCodeFoldingRange& parent, int line)
+{
+    if (parent) {
+        int index = lowerFoldIndex(parent->subFoldRanges, line+1);
+        return index>0 ? parent->subFoldRanges->range(index-1) : PCodeFoldingRange();
+    }
+    int index = lowerFoldIndex(allFoldRanges, line+1);
+    if (index==0)
+        return PCodeFoldingRange();
+    PCodeFoldingRange range = allFoldRanges->range(index-1);
+    PCodeFoldingRange rangeParent = range->parent.lock();
+    while (rangeParent) {
+        range = rangeParent;
+        rangeParent = range->parent.lock();
+    }
+    return range;
+}
+
+void QSynEdit::updateFoldRanges(int firstIndex, int lastIndex)
+{
+    if (!mUseCodeFolding)
+        return;
+    if (!mSyntaxer || mDocument->empty()) {
+        foldOnListCleared();
+        invalidateGutter();
+        return;
+    }
+    int lineCount = mDocument->count();
+    firstIndex = std::min(std::max(0, firstIndex), lineCount-1);
+    lastIndex = std::min(std::max(firstIndex, lastIndex), lineCount-1);
+
+    // Folds opened before the first line are not changed by the lines before it.
+    // A fold closes at toLine-1 (or at toLine if another block starts on that line).
+    // Unclosed folds, and folds whose closing line is unknown after deleting lines,
+    // have toLine==fromLine. When we can't tell if one is still open, start earlier.
+    QVector<FoldRangeUpdate> updates;
+    bool certain = false;
+    while (!certain) {
+        certain = true;
+        updates.clear();
+        PCodeFoldingRange parent;
+        while (firstIndex > 0) {
+            PCodeFoldingRange range = lastSubFoldAt(mAllFoldRanges, parent, firstIndex);
+            if (!range)
+                break;
+            if (range->toLine == range->fromLine) {
+                certain = false;
+                firstIndex = range->fromLine - 1;
+                break;
+            }
+            if (range->toLine < firstIndex)
+                break;
+            if (range->toLine == firstIndex) {
+                certain = false;
+                firstIndex--;
+                break;
             }
-            mAllFoldRanges->add(tempFoldRange);
+            FoldRangeUpdate update{range, range->toLine, updates.count()-1, false};
+            updates.append(update);
+            parent = range;
+        }
+    }
+    int ancestorCount = updates.count();
+
+    QVector<int> openFolds;
+    for (int i=0;i<ancestorCount;i++)
+        openFolds.append(i);
+    // The lines after lastIndex are not changed. If the old tree has the same folds
+    // open after the line, the folds after it are the same as before.
+    auto sameFoldsOpen = [this, &updates, &openFolds](int line) {
+        PCodeFoldingRange parent;
+        foreach (int i, openFolds) {
+            const FoldRangeUpdate& update = updates[i];
+            if (update.created
+                    || update.range->parent.lock() != parent
+                    || update.range->toLine < line + 2)
+                return false;
+            parent = update.range;
         }
-    } else {
-        // We ended up with no folds after deleting, just pass standard data...
-        PCodeFoldingRanges temp{mAllFoldRanges};
-        scanForFoldRanges(temp);
+        PCodeFoldingRange range = lastSubFoldAt(mAllFoldRanges, parent, line+1);
+        return !range
+                || (range->toLine <= line && range->toLine != range->fromLine);
+    };
+    int line = firstIndex;
+    while (line < lineCount) {
+        int blockEnded = mDocument->blockEnded(line);
+        int blockStarted = mDocument->blockStarted(line);
+        for (int i=0; i<blockEnded && !openFolds.isEmpty(); i++) {
+            if (blockStarted>0)
+                updates[openFolds.takeLast()].toLine = line;
+            else
+                updates[openFolds.takeLast()].toLine = line + 1;
+        }
+        if (blockStarted>0) {
+            // reuse the folds starting at the line, to keep their collapse states
+            int index = lowerFoldIndex(mAllFoldRanges, line + 1);
+            for (int i=0; i<blockStarted; i++) {
+                FoldRangeUpdate update;
+                if (index+i < mAllFoldRanges->count()
+                        && mAllFoldRanges->range(index+i)->fromLine == line + 1) {
+                    update.range = mAllFoldRanges->range(index+i);
+                    update.created = false;
+                } else {
+                    update.range = std::make_shared<CodeFoldingRange>(PCodeFoldingRange(), line + 1, line + 1);
+                    update.created = true;
+                }
+                update.toLine = line + 1;
+                update.parent = openFolds.isEmpty()?-1:openFolds.last();
+                openFolds.append(updates.count());
+                updates.append(update);
+            }
+        }
+        if (line >= lastIndex && sameFoldsOpen(line)) {
+            // they are closed at the same lines as before
+            foreach (int i, openFolds)
+                updates[i].toLine = updates[i].range->toLine;
+            break;
+        }
+        line++;
+    }
+    if (line >= lineCount) {
+        // unclosed folds
+        foreach (int i, openFolds)
+            updates[i].toLine = updates[i].range->fromLine;
+        line = lineCount - 1;
+    }
+
+    // replace folds starting in the scanned lines
+    int startIndex = lowerFoldIndex(mAllFoldRanges, firstIndex + 1);
+    int endIndex = lowerFoldIndex(mAllFoldRanges, line + 2);
+    bool collapseChanged = false;
+    QSet<CodeFoldingRange*> reusedRanges;
+    for (int i=ancestorCount;i<updates.count();i++) {
+        if (!updates[i].created)
+            reusedRanges.insert(updates[i].range.get());
+    }
+    for (int i=startIndex;i<endIndex;i++) {
+        PCodeFoldingRange range = mAllFoldRanges->range(i);
+        if (range->collapsed && !reusedRanges.contains(range.get()))
+            collapseChanged = true;
+    }
+    QVector<int> subFoldIndexes(updates.count(), 0);
+    for (int i=0;i<ancestorCount;i++) {
+        PCodeFoldingRanges subRanges = updates[i].range->subFoldRanges;
+        int subStart = lowerFoldIndex(subRanges, firstIndex + 1);
+        subRanges->remove(subStart, lowerFoldIndex(subRanges, line + 2) - subStart);
+        subFoldIndexes[i] = subStart;
+    }
+    QVector<PCodeFoldingRange> scannedRanges;
+    for (int i=0;i<updates.count();i++) {
+        const FoldRangeUpdate& update = updates[i];
+        PCodeFoldingRange range = update.range;
+        // it may be moved into or out of a collapsed fold
+        if (range->collapsed)
+            collapseChanged = true;
+        if (range->toLine != update.toLine) {
+            // the same as a new fold
+            if (range->collapsed) {
+                range->collapsed = false;
+                range->linesCollapsed = 0;
+                collapseChanged = true;
+            }
+            range->toLine = update.toLine;
+        }
+        if (i < ancestorCount)
+            continue;
+        // sub folds after the scanned lines are kept
+        range->subFoldRanges->remove(0, lowerFoldIndex(range->subFoldRanges, line + 2));
+        if (update.parent>=0) {
+            const PCodeFoldingRange& parent = updates[update.parent].range;
+            range->parent = parent;
+            parent->subFoldRanges->insert(subFoldIndexes[update.parent]++, range);
+        } else {
+            range->parent.reset();
+        }
+        scannedRanges.append(range);
     }
+    mAllFoldRanges->remove(startIndex, endIndex - startIndex);
+    mAllFoldRanges->insert(startIndex, scannedRanges);
+    if (collapseChanged)
+        mCollapsedFoldSpans.rebuild(*mAllFoldRanges);
+
+    if (collapseChanged)
+        updateScrollbars();
+    invalidateGutter();
 }
 
-void QSynEdit::scanForFoldRanges(PCodeFoldingRanges topFoldRanges)
+void QSynEdit::markFoldRangesChanged(int index)
 {
-    PCodeFoldingRanges parentFoldRanges = topFoldRanges;
-//    qint64 begin=QDateTime::currentMSecsSinceEpoch();
-
-    findSubFoldRange(topFoldRanges, parentFoldRanges,PCodeFoldingRange());
-//    qint64 diff= QDateTime::currentMSecsSinceEpoch() - begin;
-//    qDebug()<<"?"<<diff;
+    if (mSyntaxScanFoldLine<0)
+        mSyntaxScanFoldLine = index;
+    else
+        mSyntaxScanFoldLine = std::min(mSyntaxScanFoldLine, index);
 }
 
 //this func should only be used in findSubFoldRange
@@ -3498,60 +3876,6 @@ int QSynEdit::lineHasChar(int Line, int startChar, QChar character, const QStrin
     return -1;
 }
 
-void QSynEdit::findSubFoldRange(PCodeFoldingRanges topFoldRanges, PCodeFoldingRanges& parentFoldRanges, PCodeFoldingRange parent)
-{
-    PCodeFoldingRange  collapsedFold;
-    int line = 0;
-    QString curLine;
-    if (!mSyntaxer)
-        return;
-
-    while (line < mDocument->count()) { // index is valid for LinesToScan and fLines
-        // If there is a collapsed fold over here, skip it
-//        collapsedFold = collapsedFoldStartAtLine(line + 1); // only collapsed folds remain
-//        if (collapsedFold) {
-//            line = collapsedFold->toLine;
-//            continue;
-//        }
-
-        // Find an opening character on this line
-        curLine = mDocument->getLine(line);
-        int blockEnded=mDocument->blockEnded(line);
-        int blockStarted=mDocument->blockStarted(line);
-        if (blockEnded>0) {
-            for (int i=0; i<blockEnded;i++) {
-                // Stop the recursion if we find a closing char, and return to our parent
-                if (parent) {
-                    if (blockStarted>0)
-                        parent->toLine = line;
-                    else
-                        parent->toLine = line + 1;
-                    parent = parent->parent.lock();
-                    if (!parent) {
-                        parentFoldRanges = topFoldRanges;
-                    } else {
-                        parentFoldRanges = parent->subFoldRanges;
-                    }
-                }
-            }
-        }
-        if (blockStarted>0) {
-            for (int i=0; i<blockStarted;i++) {
-                // Add it to the top list of folds
-                parent = parentFoldRanges->addByParts(
-                  parent,
-                  topFoldRanges,
-                  line + 1,
-                  line + 1);
-                parentFoldRanges = parent->subFoldRanges;
-            }
-        }
-        line++;
-    }
-
-
-}
-
 PCodeFoldingRange QSynEdit::collapsedFoldStartAtLine(int Line)
 {
     for (int i = 0; i< mAllFoldRanges->count() - 1; i++ ) {
@@ -4656,6 +4980,11 @@ void QSynEdit::setUseCodeFolding(bool value)
 {
     if (mUseCodeFolding!=value) {
         mUseCodeFolding = value;
+        // folds are not maintained while it's off
+        if (mUseCodeFolding)
+            rescanFolds();
+        else
+            foldOnListCleared();
     }
 }
 
@@ -5917,7 +6246,7 @@ void QSynEdit::endEditingWithoutUndo()
 {
     mEditingCount--;
     if (mEditingCount==0)
-        reparseDocument();
+        scanEditedLines();
 }
 
 bool QSynEdit::isIdentChar(const QChar &ch)
@@ -6613,6 +6942,9 @@ void QSynEdit::onLinesChanging()
 
 void QSynEdit::onLinesCleared()
 {
+    cancelBackgroundSyntaxScan();
+    mEditingFirstLine = -1;
+    mEditingLastLine = -1;
     if (mUseCodeFolding)
         foldOnListCleared();
     clearUndo();
@@ -6629,10 +6961,21 @@ void QSynEdit::onLinesCleared()
 
 void QSynEdit::onLinesDeleted(int index, int count)
 {
-    if (mUseCodeFolding)
+    if (mUseCodeFolding) {
         foldOnListDeleted(index + 1, count);
+        markFoldRangesChanged(index);
+    }
+    if (mSyntaxScanLine > index)
+        mSyntaxScanLine = std::max(index, mSyntaxScanLine - count);
+    if (mSyntaxScanEditedLine >= index)
+        mSyntaxScanEditedLine = std::max(index, mSyntaxScanEditedLine - count);
+    if (mEditingLastLine >= index)
+        mEditingLastLine = std::max(index, mEditingLastLine - count);
+    // so the states after the deleted lines can be matched with the rescanned ones
+    mDocument->moveIndentLines(index, index, -count);
     if (mSyntaxer && mDocument->count() > 0) {
-        scanFrom(index);
+        // the last lines may be deleted, folds around them still need updating
+        scanFrom(std::min(index, mDocument->count()-1), index);
     }
     invalidateLines(index + 1, INT_MAX);
     invalidateGutterLines(index + 1, INT_MAX);
@@ -6640,19 +6983,28 @@ void QSynEdit::onLinesDeleted(int index, int count)
 
 void QSynEdit::onLinesInserted(int index, int count)
 {
-    if (mUseCodeFolding)
+    if (mUseCodeFolding) {
         foldOnListInserted(index + 1, count);
+        markFoldRangesChanged(index);
+    }
+    if (mSyntaxScanLine > index)
+        mSyntaxScanLine += count;
+    if (mSyntaxScanEditedLine >= index)
+        mSyntaxScanEditedLine += count;
+    if (mEditingLastLine >= index)
+        mEditingLastLine += count;
+    mDocument->moveIndentLines(index + count, index, count);
     if (mSyntaxer && mDocument->count() > 0) {
-          scanFrom(index);
+        scanFrom(index, index + count - 1);
     }
     invalidateLines(index + 1, INT_MAX);
     invalidateGutterLines(index + 1, INT_MAX);
 }
 
-void QSynEdit::onLinesPutted(int index, int /*count*/)
+void QSynEdit::onLinesPutted(int index, int count)
 {
     if (mSyntaxer) {
-        scanFrom(index);
+        scanFrom(index, index + count - 1);
     }
     invalidateLines(index + 1, INT_MAX);
 }
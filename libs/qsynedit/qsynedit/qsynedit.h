@@ -505,20 +505,34 @@ private:
     void recalcCharExtent();
     QString expandAtWideGlyphs(const QString& S);
     void updateModifiedStatus();
-    void scanFrom(int index);
+    // rescans syntax states from index until they are the same as before,
+    // lines up to lastEditedIndex are always rescanned
+    void scanFrom(int index, int lastEditedIndex);
+    void scanEditedLines();
+    // returns true if the state of the line is not changed by the scan
+    bool rescanLineState(int index, bool& foldChanged);
+    void startBackgroundSyntaxScan(int index, int lastEditedIndex);
+    void cancelBackgroundSyntaxScan();
     void reparseLine(int line);
     void reparseDocument();
     void uncollapse(PCodeFoldingRange FoldRange);
+    // uncollapse without rebuilding the collapsed spans, for loops over the folds that rebuild them once at the end
+    void uncollapseWithoutRebuild(PCodeFoldingRange FoldRange);
     void collapse(PCodeFoldingRange FoldRange);
+    void collapseWithoutRebuild(PCodeFoldingRange FoldRange);
+    // move the caret out of the fold if it's hidden
+    void extractCaretFromFold(PCodeFoldingRange FoldRange);
 
     void foldOnListInserted(int Line, int Count);
     void foldOnListDeleted(int Line, int Count);
     void foldOnListCleared();
     void rescanFolds(); // rescan for folds
     void rescanForFoldRanges();
-    void scanForFoldRanges(PCodeFoldingRanges topFoldRanges);
+    // rebuilds folds of lines from firstIndex, folds after lastIndex are reused
+    // once the same folds are open as before
+    void updateFoldRanges(int firstIndex, int lastIndex);
+    void markFoldRangesChanged(int index);
     int lineHasChar(int Line, int startChar, QChar character, const QString& tokenAttrName);
-    void findSubFoldRange(PCodeFoldingRanges topFoldRanges,PCodeFoldingRanges& parentFoldRanges, PCodeFoldingRange Parent);
     PCodeFoldingRange collapsedFoldStartAtLine(int Line);
     void initializeCaret();
     PCodeFoldingRange foldStartAtLine(int Line) const;
@@ -633,6 +647,7 @@ private slots:
     void onLinesPutted(int index, int count);
     //void onRedoAdded();
     void onScrollTimeout();
+    void onSyntaxScanTimeout();
     void onDraggingScrollTimeout();
     void onUndoAdded();
     void onSizeOrFontChanged(bool bFont);
@@ -642,6 +657,7 @@ private slots:
 private:
     std::shared_ptr<QImage> mContentImage;
     PCodeFoldingRanges mAllFoldRanges;
+    CollapsedFoldSpans mCollapsedFoldSpans;
     CodeFoldingOptions mCodeFolding;
     int mEditingCount;
     bool mUseCodeFolding;
@@ -708,6 +724,12 @@ private:
     //  fFocusList: TList;
     //  fPlugins: TList;
     QTimer*  mScrollTimer;
+    QTimer*  mSyntaxScanTimer;
+    int mSyntaxScanLine; // states from the line are being rescanned in the background, -1 if none
+    int mSyntaxScanEditedLine; // the background scan can't stop before passing it
+    int mSyntaxScanFoldLine; // fold ranges from the line should be updated after the scan is done, -1 if none
+    int mEditingFirstLine; // lines changed while editing are rescanned when it ends, -1 if none
+    int mEditingLastLine;
     int mScrollDeltaX;
     int mScrollDeltaY;
 
@@ -0,0 +1,50 @@
+#include "geometry.h"
+
+namespace geometry {
+
+Circle::Circle(Point center, double radius):
+    mCenter(center),
+    mRadius(radius)
+{
+}
+
+double Circle::area() const
+{
+    return M_PI * mRadius * mRadius;
+}
+
+double Circle::perimeter() const
+{
+    return 2 * M_PI * mRadius;
+}
+
+Polygon::Polygon(const std::vector<Point> &points):
+    mPoints(points)
+{
+}
+
+double Polygon::area() const
+{
+    double sum = 0;
+    for (size_t i=0;i<mPoints.size();i++) {
+        const Point& a = mPoints[i];
+        const Point& b = mPoints[(i+1) % mPoints.size()];
+        sum += a.x * b.y - b.x * a.y;
+    }
+    return std::fabs(sum) / 2;
+}
+
+double Polygon::perimeter() const
+{
+    double sum = 0;
+    for (size_t i=0;i<mPoints.size();i++)
+        sum += distance(mPoints[i], mPoints[(i+1) % mPoints.size()]);
+    return sum;
+}
+
+double distance(const Point &a, const Point &b)
+{
+    return std::hypot(a.x - b.x, a.y - b.y);
+}
+
+}
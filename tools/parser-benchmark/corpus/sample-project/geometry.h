@@ -0,0 +1,44 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <cmath>
+#include <vector>
+
+namespace geometry {
+
+struct Point {
+    double x;
+    double y;
+};
+
+class Shape {
+public:
+    virtual ~Shape() = default;
+    virtual double area() const = 0;
+    virtual double perimeter() const = 0;
+};
+
+class Circle : public Shape {
+public:
+    Circle(Point center, double radius);
+    double area() const override;
+    double perimeter() const override;
+private:
+    Point mCenter;
+    double mRadius;
+};
+
+class Polygon : public Shape {
+public:
+    explicit Polygon(const std::vector<Point>& points);
+    double area() const override;
+    double perimeter() const override;
+private:
+    std::vector<Point> mPoints;
+};
+
+double distance(const Point& a, const Point& b);
+
+}
+
+#endif
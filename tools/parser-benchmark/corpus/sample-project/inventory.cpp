@@ -0,0 +1,39 @@
+#include "inventory.h"
+
+void Inventory::add(const std::string &name, int quantity, double price)
+{
+    PItem item = find(name);
+    if (item) {
+        item->quantity += quantity;
+        item->price = price;
+        return;
+    }
+    mItems[name] = std::make_shared<Item>(Item{name, quantity, price});
+}
+
+bool Inventory::remove(const std::string &name, int quantity)
+{
+    PItem item = find(name);
+    if (!item || item->quantity < quantity)
+        return false;
+    item->quantity -= quantity;
+    if (item->quantity == 0)
+        mItems.erase(name);
+    return true;
+}
+
+PItem Inventory::find(const std::string &name) const
+{
+    auto it = mItems.find(name);
+    if (it == mItems.end())
+        return PItem();
+    return it->second;
+}
+
+double Inventory::totalValue() const
+{
+    double sum = 0;
+    for (const auto& pair : mItems)
+        sum += pair.second->quantity * pair.second->price;
+    return sum;
+}
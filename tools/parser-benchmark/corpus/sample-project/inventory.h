@@ -0,0 +1,26 @@
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include <map>
+#include <memory>
+#include <string>
+
+struct Item {
+    std::string name;
+    int quantity;
+    double price;
+};
+
+using PItem = std::shared_ptr<Item>;
+
+class Inventory {
+public:
+    void add(const std::string& name, int quantity, double price);
+    bool remove(const std::string& name, int quantity);
+    PItem find(const std::string& name) const;
+    double totalValue() const;
+private:
+    std::map<std::string, PItem> mItems;
+};
+
+#endif
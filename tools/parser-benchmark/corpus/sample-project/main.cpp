@@ -0,0 +1,17 @@
+#include <iostream>
+#include "geometry.h"
+#include "inventory.h"
+
+int main()
+{
+    geometry::Circle circle({0, 0}, 2);
+    geometry::Polygon square({{0, 0}, {1, 0}, {1, 1}, {0, 1}});
+    std::cout << circle.area() << " " << square.perimeter() << std::endl;
+
+    Inventory inventory;
+    inventory.add("apple", 10, 0.5);
+    inventory.add("pear", 4, 0.8);
+    inventory.remove("apple", 3);
+    std::cout << inventory.totalValue() << std::endl;
+    return 0;
+}
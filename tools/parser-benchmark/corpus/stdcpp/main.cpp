@@ -0,0 +1,11 @@
+// The whole libstdc++, the worst case of parsing a single file.
+#include <bits/stdc++.h>
+
+int main()
+{
+    std::vector<int> numbers {3, 1, 2};
+    std::sort(numbers.begin(), numbers.end());
+    for (int n:numbers)
+        std::cout<<n<<std::endl;
+    return 0;
+}
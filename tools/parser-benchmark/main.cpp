@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2020-2022 Roy Qu (royqh1979@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Parses a set of source files with the code parser of Red Panda C++,
+ * without starting the IDE, and reports the time spent in each phase
+ * (preprocess, tokenize, parse) as json.
+ */
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QTextStream>
+#include <memory>
+
+#include "parser/cppparser.h"
+#include "parser/preprocessedheadercache.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef Q_OS_WIN
+#   define NULL_FILE       "NUL"
+#else
+#   define NULL_FILE       "/dev/null"
+#endif
+
+static const QStringList SourceSuffixes {
+    "c", "cpp", "cc", "cxx", "c++",
+    "h", "hpp", "hh", "hxx", "h++"
+};
+
+struct BenchmarkOptions {
+    QStringList files;
+    QStringList includeDirs;
+    QStringList projectIncludeDirs;
+    QStringList defines;
+    bool isCpp;
+    bool parallel;
+    bool warmCaches;
+    int repeat;
+};
+
+static double nsToMs(qint64 ns)
+{
+    return ns / 1000000.0;
+}
+
+// in KB
+static qint64 peakMemoryUsage()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize / 1024;
+    return -1;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage)!=0)
+        return -1;
+#ifdef Q_OS_MACOS
+    // in bytes on macOS
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+static void collectSourceFiles(const QString& path, QStringList& files)
+{
+    QFileInfo info(path);
+    if (info.isFile()) {
+        files.append(info.absoluteFilePath());
+        return;
+    }
+    if (!info.isDir())
+        return;
+    QDirIterator it(info.absoluteFilePath(), QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QFileInfo fileInfo(it.next());
+        if (SourceSuffixes.contains(fileInfo.suffix(), Qt::CaseInsensitive))
+            files.append(fileInfo.absoluteFilePath());
+    }
+}
+
+static QByteArray runCompiler(const QString& compiler, const QStringList& arguments)
+{
+    QProcess process;
+    process.setProcessChannelMode(QProcess::MergedChannels);
+    process.start(compiler, arguments);
+    process.closeWriteChannel();
+    if (!process.waitForFinished(30000))
+        return QByteArray();
+    return process.readAll();
+}
+
+// search dirs and predefined macros of the compiler, the same way compiler sets are set up in the IDE
+static void queryCompiler(const QString& compiler, bool isCpp, BenchmarkOptions& options)
+{
+    QString language = isCpp?"c++":"c";
+    QByteArray output = runCompiler(compiler, {"-x"+language, "-E", "-v", NULL_FILE});
+    int start = output.indexOf("#include <...> search starts here:");
+    int end = output.indexOf("End of search list.");
+    if (start>=0 && end>start) {
+        QList<QByteArray> lines = output.mid(start, end-start).split('\n');
+        for (int i=1;i<lines.count();i++) {
+            QString dir = QString::fromLocal8Bit(lines[i].trimmed());
+            if (dir.endsWith(" (framework directory)"))
+                continue;
+            if (!dir.isEmpty())
+                options.includeDirs.append(QDir::cleanPath(dir));
+        }
+    }
+    output = runCompiler(compiler, {"-dM", "-E", "-x", language, NULL_FILE});
+    foreach (const QByteArray& line, output.split('\n')) {
+        QByteArray trimmedLine = line.trimmed();
+        if (trimmedLine.startsWith("#define"))
+            options.defines.append(QString::fromLocal8Bit(trimmedLine));
+    }
+}
+
+static QJsonObject runRound(const BenchmarkOptions& options)
+{
+    if (!options.warmCaches)
+        PreprocessedHeaderCache::clear();
+
+    std::shared_ptr<CppParser> parser = std::make_shared<CppParser>();
+    parser->setLanguage(options.isCpp?ParserLanguage::CPlusPlus:ParserLanguage::C);
+    parser->setEnabled(true);
+    parser->setParseGlobalHeaders(true);
+    parser->setParseLocalHeaders(true);
+    parser->setParallelParsing(options.parallel);
+    foreach (const QString& dir, options.includeDirs)
+        parser->addIncludePath(dir);
+    foreach (const QString& dir, options.projectIncludeDirs)
+        parser->addProjectIncludePath(dir);
+    foreach (const QString& define, options.defines)
+        parser->addHardDefineByLine(define);
+    parser->parseHardDefines();
+    foreach (const QString& file, options.files)
+        parser->addProjectFile(file, true);
+    parser->setCollectStatistics(true);
+
+    QElapsedTimer timer;
+    timer.start();
+    parser->parseFileList(false);
+    qint64 wallTime = timer.nsecsElapsed();
+
+    qint64 preprocessTime = 0;
+    qint64 tokenizeTime = 0;
+    qint64 parseTime = 0;
+    qint64 tokenCount = 0;
+    QJsonArray files;
+    foreach (const FileParseStatistics& statistics, parser->statistics()) {
+        preprocessTime += statistics.preprocessTime;
+        tokenizeTime += statistics.tokenizeTime;
+        parseTime += statistics.parseTime;
+        tokenCount += statistics.tokenCount;
+        QJsonObject file;
+        file["file"] = statistics.fileName;
+        file["preprocessMs"] = nsToMs(statistics.preprocessTime);
+        file["tokenizeMs"] = nsToMs(statistics.tokenizeTime);
+        file["parseMs"] = nsToMs(statistics.parseTime);
+        file["tokens"] = statistics.tokenCount;
+        file["statements"] = statistics.statementCount;
+        files.append(file);
+    }
+
+    QJsonObject round;
+    round["wallMs"] = nsToMs(wallTime);
+    round["preprocessMs"] = nsToMs(preprocessTime);
+    round["tokenizeMs"] = nsToMs(tokenizeTime);
+    round["parseMs"] = nsToMs(parseTime);
+    round["tokens"] = tokenCount;
+    round["statements"] = parser->statementList().count();
+    round["scannedFiles"] = parser->scannedFiles().count();
+    round["files"] = files;
+    return round;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("parser-benchmark");
+
+    QCommandLineParser cmdParser;
+    cmdParser.setApplicationDescription("Benchmark the code parser of Red Panda C++.");
+    cmdParser.addHelpOption();
+    cmdParser.addPositionalArgument("paths", "Source files, or directories to search for source files.", "<path>...");
+    QCommandLineOption includeOption("I", "Add a system include directory.", "dir");
+    QCommandLineOption projectIncludeOption("P", "Add a project include directory.", "dir");
+    QCommandLineOption defineOption("D", "Predefine a macro.", "name[=value]");
+    QCommandLineOption compilerOption("compiler", "Take include directories and predefined macros from the gcc/clang compiler.", "program");
+    QCommandLineOption cOption("c", "Parse as C instead of C++.");
+    QCommandLineOption parallelOption("parallel", "Preprocess files in parallel.");
+    QCommandLineOption repeatOption("repeat", "Parse the files n times.", "n", "1");
+    QCommandLineOption warmCachesOption("warm-caches", "Keep the preprocessed header cache between rounds.");
+    QCommandLineOption outputOption({"o","output"}, "Write the result to the file instead of stdout.", "file");
+    cmdParser.addOptions({includeOption, projectIncludeOption, defineOption, compilerOption,
+                          cOption, parallelOption, repeatOption, warmCachesOption, outputOption});
+    cmdParser.process(app);
+
+    BenchmarkOptions options;
+    options.isCpp = !cmdParser.isSet(cOption);
+    options.parallel = cmdParser.isSet(parallelOption);
+    options.warmCaches = cmdParser.isSet(warmCachesOption);
+    bool ok;
+    options.repeat = cmdParser.value(repeatOption).toInt(&ok);
+    if (!ok || options.repeat<1) {
+        QTextStream(stderr)<<"Invalid repeat count: "<<cmdParser.value(repeatOption)<<Qt::endl;
+        return 1;
+    }
+    foreach (const QString& path, cmdParser.positionalArguments())
+        collectSourceFiles(path, options.files);
+    if (options.files.isEmpty()) {
+        QTextStream(stderr)<<"No source files to parse."<<Qt::endl;
+        return 1;
+    }
+    if (cmdParser.isSet(compilerOption))
+        queryCompiler(cmdParser.value(compilerOption), options.isCpp, options);
+    foreach (const QString& dir, cmdParser.values(includeOption))
+        options.includeDirs.append(QDir(dir).absolutePath());
+    foreach (const QString& dir, cmdParser.values(projectIncludeOption))
+        options.projectIncludeDirs.append(QDir(dir).absolutePath());
+    foreach (const QString& define, cmdParser.values(defineOption)) {
+        int pos = define.indexOf('=');
+        if (pos<0)
+            options.defines.append("#define "+define+" 1");
+        else
+            options.defines.append("#define "+define.left(pos)+" "+define.mid(pos+1));
+    }
+
+    QJsonArray rounds;
+    for (int i=0;i<options.repeat;i++)
+        rounds.append(runRound(options));
+
+    QJsonObject result;
+    result["language"] = options.isCpp?"c++":"c";
+    result["parallel"] = options.parallel;
+    result["warmCaches"] = options.warmCaches;
+    result["fileCount"] = options.files.count();
+    result["rounds"] = rounds;
+    result["peakMemoryKB"] = peakMemoryUsage();
+
+    QByteArray json = QJsonDocument(result).toJson();
+    if (cmdParser.isSet(outputOption)) {
+        QFile file(cmdParser.value(outputOption));
+        if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+            QTextStream(stderr)<<"Can't open file '"<<file.fileName()<<"' for write."<<Qt::endl;
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QFile out;
+        out.open(stdout, QFile::WriteOnly);
+        out.write(json);
+    }
+    return 0;
+}
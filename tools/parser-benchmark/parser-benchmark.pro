@@ -0,0 +1,59 @@
+QT += core gui widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# windows 7 is the minimum windows version
+win32: {
+DEFINES += _WIN32_WINNT=0x0601
+}
+
+msvc {
+    DEFINES += NOMINMAX
+}
+
+CONFIG(debug_and_release_target) {
+    CONFIG(debug, debug|release) {
+        OBJ_OUT_PWD = debug/
+    }
+    CONFIG(release, debug|release) {
+        OBJ_OUT_PWD = release/
+    }
+}
+
+INCLUDEPATH += ../../RedPandaIDE ../../libs/qsynedit ../../libs/redpanda_qt_utils
+
+gcc | clang {
+LIBS += $$OUT_PWD/../../libs/qsynedit/$${OBJ_OUT_PWD}libqsynedit.a \
+        $$OUT_PWD/../../libs/redpanda_qt_utils/$${OBJ_OUT_PWD}libredpanda_qt_utils.a
+}
+msvc {
+LIBS += $$OUT_PWD/../../libs/qsynedit/$${OBJ_OUT_PWD}qsynedit.lib \
+        $$OUT_PWD/../../libs/redpanda_qt_utils/$${OBJ_OUT_PWD}redpanda_qt_utils.lib
+LIBS += advapi32.lib user32.lib
+}
+
+win32: {
+LIBS += -lpsapi
+}
+
+SOURCES += \
+    main.cpp \
+    ../../RedPandaIDE/parser/cppparser.cpp \
+    ../../RedPandaIDE/parser/cpppreprocessor.cpp \
+    ../../RedPandaIDE/parser/cpptokenizer.cpp \
+    ../../RedPandaIDE/parser/parserutils.cpp \
+    ../../RedPandaIDE/parser/parsescheduler.cpp \
+    ../../RedPandaIDE/parser/preprocessedheadercache.cpp \
+    ../../RedPandaIDE/parser/statementmodel.cpp \
+    ../../RedPandaIDE/parser/systemheadercache.cpp
+
+HEADERS += \
+    ../../RedPandaIDE/parser/cppparser.h \
+    ../../RedPandaIDE/parser/cpppreprocessor.h \
+    ../../RedPandaIDE/parser/cpptokenizer.h \
+    ../../RedPandaIDE/parser/parserutils.h \
+    ../../RedPandaIDE/parser/parsescheduler.h \
+    ../../RedPandaIDE/parser/preprocessedheadercache.h \
+    ../../RedPandaIDE/parser/statementmodel.h \
+    ../../RedPandaIDE/parser/systemheadercache.h